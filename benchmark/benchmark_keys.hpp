@@ -0,0 +1,16 @@
+#ifndef PDS_BENCHMARK_KEYS_HPP
+#define PDS_BENCHMARK_KEYS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+inline std::vector<uint64_t> random_keys(std::size_t n, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<uint64_t> keys(n);
+  for (auto &key : keys) key = rng();
+  return keys;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include "binary_fuse_filter.hpp"
+#include "xor_filter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_keys.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Binary fuse filters against xor filters on state.range(0) keys:
+// construction time, and lookups alternating between members and
+// non-members, with the space taken as a counter.
+
+template <typename Filter>
+static void BM_fingerprint_filter_build(benchmark::State &state) {
+  const auto keys = random_keys(state.range(0), 1);
+  double bits_per_key = 0;
+  for (auto _ : state) {
+    Filter filter(keys.begin(), keys.end());
+    bits_per_key = filter.bits_per_key();
+    benchmark::DoNotOptimize(filter.seed());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+  state.counters["bits_per_key"] = bits_per_key;
+}
+template <typename Filter>
+static void BM_fingerprint_filter_contains(benchmark::State &state) {
+  const auto keys = random_keys(state.range(0), 1);
+  const auto others = random_keys(1 << 20, 2);
+  const Filter filter(keys.begin(), keys.end());
+  std::size_t i = 0, hits = 0;
+  for (auto _ : state) {
+    const auto j = i++;
+    hits += filter.contains(j & 1 ? keys[(j * 7919) % keys.size()]
+                                  : others[j & ((1 << 20) - 1)]);
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+
+#define PDS_FINGERPRINT_FILTER_BENCHMARKS(...)                       \
+  BENCHMARK(BM_fingerprint_filter_build<__VA_ARGS__>)                \
+      ->Arg(1 << 20)                                                 \
+      ->Arg(1 << 24)                                                 \
+      ->Unit(benchmark::kMillisecond);                               \
+  BENCHMARK(BM_fingerprint_filter_contains<__VA_ARGS__>)->Arg(1 << 24)
+
+PDS_FINGERPRINT_FILTER_BENCHMARKS(pds::xor8_filter<uint64_t>);
+PDS_FINGERPRINT_FILTER_BENCHMARKS(pds::binary_fuse8_filter<uint64_t>);
+PDS_FINGERPRINT_FILTER_BENCHMARKS(pds::binary_fuse8_filter<uint64_t, 4>);
+#undef PDS_FINGERPRINT_FILTER_BENCHMARKS
@@ -0,0 +1,296 @@
+#include "bloom_filter.hpp"
+#include "huge_page_allocator.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_keys.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Insert and lookup throughput with k hashes per key for each generator.
+template <typename Generator>
+static void BM_bloom_filter_insert(benchmark::State &state) {
+  const auto keys = random_keys(1 << 16, 1);
+  pds::bloom_filter<uint64_t, Generator> bf(std::size_t{1} << 22,
+                                            std::size_t(state.range(0)));
+  std::size_t i = 0;
+  for (auto _ : state) {
+    bf.insert(keys[i++ & (keys.size() - 1)]);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+template <typename Generator>
+static void BM_bloom_filter_contains(benchmark::State &state) {
+  const auto keys = random_keys(1 << 16, 1);
+  pds::bloom_filter<uint64_t, Generator> bf(std::size_t{1} << 22,
+                                            std::size_t(state.range(0)));
+  bf.insert(keys.begin(), keys.end());
+  std::size_t i = 0, hits = 0;
+  for (auto _ : state) {
+    hits += bf.contains(keys[i++ & (keys.size() - 1)]);
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_bloom_filter_insert<pds::hash::default_hash_generator<uint64_t>>)
+    ->DenseRange(2, 14, 4);
+BENCHMARK(BM_bloom_filter_insert<pds::hash::double_hash_generator<uint64_t>>)
+    ->DenseRange(2, 14, 4);
+BENCHMARK(
+    BM_bloom_filter_contains<pds::hash::default_hash_generator<uint64_t>>)
+    ->DenseRange(2, 14, 4);
+BENCHMARK(BM_bloom_filter_contains<pds::hash::double_hash_generator<uint64_t>>)
+    ->DenseRange(2, 14, 4);
+
+// Lookups on a filter larger than the last level cache, one key at a time
+// versus the prefetching batch path.
+static void BM_bloom_filter_contains_dram(benchmark::State &state) {
+  const auto keys = random_keys(1 << 20, 2);
+  pds::bloom_filter<uint64_t, pds::hash::double_hash_generator<uint64_t>> bf(
+      std::size_t{1} << 31, std::size_t{7});
+  bf.insert(keys.begin(), keys.end());
+  std::size_t hits = 0;
+  for (auto _ : state) {
+    for (auto key : keys) hits += bf.contains(key);
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+static void BM_bloom_filter_contains_batch_dram(benchmark::State &state) {
+  const auto keys = random_keys(1 << 20, 2);
+  pds::bloom_filter<uint64_t, pds::hash::double_hash_generator<uint64_t>> bf(
+      std::size_t{1} << 31, std::size_t{7});
+  bf.insert_batch(keys);
+  auto results = std::make_unique<bool[]>(keys.size());
+  std::size_t hits = 0;
+  for (auto _ : state) {
+    hits += bf.contains_batch(keys, {results.get(), keys.size()});
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_bloom_filter_contains_dram)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_bloom_filter_contains_batch_dram)->Unit(benchmark::kMillisecond);
+
+// Latency of dependent lookups (each key depends on the previous result) on a
+// 512 MiB filter, backed by 4 KiB pages versus 2 MiB pages. With 4 KiB pages
+// nearly every probe also misses the TLB.
+template <typename Allocator>
+static void BM_bloom_filter_contains_latency(benchmark::State &state) {
+  const auto keys = random_keys(1 << 20, 4);
+  pds::bloom_filter<uint64_t, pds::hash::double_hash_generator<uint64_t>,
+                    Allocator>
+      bf(std::size_t{1} << 32, std::size_t{4});
+  bf.insert(keys.begin(), keys.end());
+  std::size_t i = 0;
+  uint64_t hit = 0;
+  for (auto _ : state) {
+    hit = bf.contains(keys[(i++ + hit) & (keys.size() - 1)]);
+  }
+  benchmark::DoNotOptimize(hit);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_bloom_filter_contains_latency<std::allocator<unsigned long>>);
+BENCHMARK(
+    BM_bloom_filter_contains_latency<pds::huge_page_allocator<unsigned long>>);
+
+// Set algebra throughput in bytes of filter touched per second. The filters
+// are 32 MiB each, larger than the last level cache.
+using merge_filter = pds::bloom_filter<uint64_t>;
+constexpr std::size_t merge_bits = std::size_t{1} << 28;
+
+static void BM_bloom_filter_union_in_place(benchmark::State &state) {
+  merge_filter a(merge_bits, std::size_t{4}), b(merge_bits, std::size_t{4});
+  for (auto _ : state) {
+    a |= b;
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * merge_bits / 8);
+}
+BENCHMARK(BM_bloom_filter_union_in_place)->Unit(benchmark::kMillisecond);
+
+static void BM_bloom_filter_union_three_operand(benchmark::State &state) {
+  merge_filter a(merge_bits, std::size_t{4}), b(merge_bits, std::size_t{4}),
+      dst(merge_bits, std::size_t{4});
+  for (auto _ : state) {
+    dst.unite(a, b);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * 3 * merge_bits / 8);
+}
+BENCHMARK(BM_bloom_filter_union_three_operand)->Unit(benchmark::kMillisecond);
+
+// Merging state.range(0) shards into one: repeated |= versus merge_all. Bytes
+// count each input once, which is what a rollup has to read.
+static void BM_bloom_filter_merge_repeated(benchmark::State &state) {
+  std::vector<merge_filter> shards(state.range(0),
+                                   merge_filter(merge_bits, std::size_t{4}));
+  merge_filter dst(merge_bits, std::size_t{4});
+  for (auto _ : state) {
+    for (const auto &shard : shards) dst |= shard;
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * shards.size() * merge_bits / 8);
+}
+static void BM_bloom_filter_merge_all(benchmark::State &state) {
+  std::vector<merge_filter> shards(state.range(0),
+                                   merge_filter(merge_bits, std::size_t{4}));
+  std::vector<const merge_filter *> inputs;
+  for (const auto &shard : shards) inputs.push_back(&shard);
+  merge_filter dst(merge_bits, std::size_t{4});
+  for (auto _ : state) {
+    dst.merge_all(inputs);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * shards.size() * merge_bits / 8);
+}
+BENCHMARK(BM_bloom_filter_merge_repeated)
+    ->Arg(16)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_bloom_filter_merge_all)->Arg(16)->Unit(benchmark::kMillisecond);
+
+// Fill counting over a 32 MiB filter: word-by-word std::popcount versus the
+// libpopcnt kernel behind num_set_bits.
+static void BM_bloom_filter_popcount_words(benchmark::State &state) {
+  merge_filter bf(merge_bits, std::size_t{4});
+  for (auto _ : state) {
+    std::size_t n = 0;
+    for (auto word : bf.data()) n += std::popcount(word);
+    benchmark::DoNotOptimize(n);
+  }
+  state.SetBytesProcessed(state.iterations() * merge_bits / 8);
+}
+static void BM_bloom_filter_num_set_bits(benchmark::State &state) {
+  merge_filter bf(merge_bits, std::size_t{4});
+  for (auto _ : state) benchmark::DoNotOptimize(bf.num_set_bits());
+  state.SetBytesProcessed(state.iterations() * merge_bits / 8);
+}
+BENCHMARK(BM_bloom_filter_popcount_words)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_bloom_filter_num_set_bits)->Unit(benchmark::kMillisecond);
+
+// Every sizing policy with every range function, for lookups on a filter of
+// about 2^24 bits. The prime and exact policies need a true modulo; mod_range
+// divides on every probe while fast_mod_range multiplies by a constant
+// precomputed for the filter's size. fast_range maps instead of reducing and
+// pow_2_range only applies to power of two sizes.
+template <typename Sizing, typename Range>
+static void BM_bloom_filter_sizing_range(benchmark::State &state) {
+  const auto keys = random_keys(1 << 16, 6);
+  pds::bloom_filter<uint64_t,
+                    pds::hash::double_hash_generator<uint64_t, Range>,
+                    std::allocator<unsigned long>, Sizing>
+      bf(std::size_t{15000000}, std::size_t{6});
+  for (std::size_t i = 0; i < keys.size(); i += 2) bf.insert(keys[i]);
+  std::size_t i = 0, hits = 0;
+  for (auto _ : state) hits += bf.contains(keys[i++ & (keys.size() - 1)]);
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+
+#define PDS_SIZING_RANGE_BENCHMARKS(Sizing)                                  \
+  BENCHMARK(BM_bloom_filter_sizing_range<Sizing,                             \
+                                         pds::hash::mod_range<uint64_t>>);   \
+  BENCHMARK(BM_bloom_filter_sizing_range<Sizing,                             \
+                                         pds::hash::fast_range<uint64_t>>);  \
+  BENCHMARK(                                                                 \
+      BM_bloom_filter_sizing_range<Sizing, pds::hash::fast_mod_range<uint64_t>>)
+
+PDS_SIZING_RANGE_BENCHMARKS(pds::bloom_filter_policy::power_of_two);
+PDS_SIZING_RANGE_BENCHMARKS(pds::bloom_filter_policy::prime);
+PDS_SIZING_RANGE_BENCHMARKS(pds::bloom_filter_policy::exact);
+PDS_SIZING_RANGE_BENCHMARKS(
+    pds::bloom_filter_policy::word_multiple<unsigned long>);
+BENCHMARK(BM_bloom_filter_sizing_range<pds::bloom_filter_policy::power_of_two,
+                                       pds::hash::pow_2_range<uint64_t>>);
+#undef PDS_SIZING_RANGE_BENCHMARKS
+
+// Building a 256 MiB filter from 8M keys with state.range(0) threads.
+static void BM_bloom_filter_build_parallel(benchmark::State &state) {
+  const auto keys = random_keys(1 << 23, 7);
+  merge_filter bf(std::size_t{1} << 31, std::size_t{4});
+  for (auto _ : state) {
+    bf.insert_parallel(keys.begin(), keys.end(),
+                       static_cast<unsigned>(state.range(0)));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_bloom_filter_build_parallel)
+    ->RangeMultiplier(2)
+    ->Range(1, 64)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Lookups of 32-byte string keys arriving as std::string_view: hashed in
+// place, versus converted to std::string first as a filter without
+// heterogeneous lookup requires.
+static void BM_bloom_filter_contains_string_view(benchmark::State &state) {
+  std::vector<std::string> keys;
+  for (auto key : random_keys(1 << 14, 8)) {
+    keys.push_back(std::to_string(key));
+    keys.back().resize(32, '-');
+  }
+  pds::bloom_filter<std::string, pds::hash::double_hash_generator<std::string>>
+      bf(keys.size(), 0.01);
+  bf.insert(keys.begin(), keys.end());
+  const std::vector<std::string_view> views(keys.begin(), keys.end());
+  std::size_t i = 0, hits = 0;
+  if (state.range(0)) {
+    for (auto _ : state) hits += bf.contains(views[i++ & (views.size() - 1)]);
+  } else {
+    for (auto _ : state)
+      hits += bf.contains(std::string(views[i++ & (views.size() - 1)]));
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_bloom_filter_contains_string_view)->Arg(0)->Arg(1);
+
+// One key checked against 32 filters of 8 MiB each, as in an LSM tree with a
+// filter per file: hashing the key for every filter, versus hashing it once
+// and probing all filters with probe_all.
+using lsm_filter =
+    pds::bloom_filter<uint64_t, pds::hash::double_hash_generator<uint64_t>>;
+static std::vector<lsm_filter> lsm_filters() {
+  std::vector<lsm_filter> filters;
+  for (std::size_t i = 0; i < 32; ++i) {
+    filters.emplace_back(std::size_t{1} << 26, std::size_t{7});
+    const auto keys = random_keys(1 << 16, 100 + i);
+    filters.back().insert(keys.begin(), keys.end());
+  }
+  return filters;
+}
+static void BM_bloom_filter_probe_each(benchmark::State &state) {
+  const auto filters = lsm_filters();
+  const auto keys = random_keys(1 << 16, 9);
+  std::size_t i = 0;
+  std::uint64_t hits = 0;
+  for (auto _ : state) {
+    const auto key = keys[i++ & (keys.size() - 1)];
+    for (std::size_t f = 0; f < filters.size(); ++f)
+      hits ^= std::uint64_t{filters[f].contains(key)} << f;
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+static void BM_bloom_filter_probe_all(benchmark::State &state) {
+  const auto filters = lsm_filters();
+  const auto keys = random_keys(1 << 16, 9);
+  std::size_t i = 0;
+  std::uint64_t hits = 0;
+  for (auto _ : state) {
+    const auto key = keys[i++ & (keys.size() - 1)];
+    hits ^= lsm_filter::probe_all(filters[0].prehash(key), filters);
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_bloom_filter_probe_each);
+BENCHMARK(BM_bloom_filter_probe_all);
@@ -0,0 +1,56 @@
+#include "concurrent_bloom_filter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace {
+
+using filter_type =
+    pds::concurrent_bloom_filter<uint64_t,
+                                 pds::hash::double_hash_generator<uint64_t>>;
+std::unique_ptr<filter_type> shared_filter;
+
+void make_shared_filter(const benchmark::State &) {
+  shared_filter = std::make_unique<filter_type>(std::size_t{1} << 30,
+                                                std::size_t{7});
+}
+void drop_shared_filter(const benchmark::State &) { shared_filter.reset(); }
+
+int max_threads() {
+  return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+}  // namespace
+
+// Insert throughput of one shared filter from 1 to N threads. Every thread
+// inserts its own key stream; items_per_second is the aggregate rate.
+static void BM_concurrent_bloom_filter_insert(benchmark::State &state) {
+  uint64_t key = uint64_t(state.thread_index()) << 40;
+  for (auto _ : state) {
+    shared_filter->insert(key++);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_concurrent_bloom_filter_insert)
+    ->Setup(make_shared_filter)
+    ->Teardown(drop_shared_filter)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+
+static void BM_concurrent_bloom_filter_contains(benchmark::State &state) {
+  uint64_t key = uint64_t(state.thread_index()) << 40;
+  std::size_t hits = 0;
+  for (auto _ : state) {
+    hits += shared_filter->contains(key++);
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_concurrent_bloom_filter_contains)
+    ->Setup(make_shared_filter)
+    ->Teardown(drop_shared_filter)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
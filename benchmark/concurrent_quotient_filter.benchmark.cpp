@@ -0,0 +1,135 @@
+#include "concurrent_quotient_filter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// 2^26 home slots with 8-bit remainders. Every thread inserts its own key
+// stream and, once it is window keys ahead, erases the key inserted window
+// keys before, so the load stays below about half.
+using filter_type = pds::concurrent_quotient_filter<uint64_t>;
+constexpr std::size_t quotient_bits = 26;
+std::unique_ptr<filter_type> shared_filter;
+
+// The alternative: one quotient filter behind a mutex.
+struct locked_filter {
+  std::mutex mutex;
+  pds::quotient_filter<uint64_t> filter{quotient_bits, std::size_t{8}};
+};
+std::unique_ptr<locked_filter> shared_locked_filter;
+
+int max_threads() {
+  return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+uint64_t window(const benchmark::State &state) {
+  return (uint64_t{1} << (quotient_bits - 1)) /
+         static_cast<uint64_t>(state.threads());
+}
+
+void make_shared_filter(const benchmark::State &) {
+  shared_filter =
+      std::make_unique<filter_type>(quotient_bits, std::size_t{8});
+}
+void drop_shared_filter(const benchmark::State &) { shared_filter.reset(); }
+// Half full, for lookups: keys 0 to 2^25 - 1.
+constexpr uint64_t filled_keys = uint64_t{1} << (quotient_bits - 1);
+void make_filled_filter(const benchmark::State &) {
+  std::vector<uint64_t> hashes(filled_keys);
+  for (uint64_t key = 0; key < filled_keys; ++key)
+    hashes[key] = static_cast<uint64_t>(
+        filter_type::hash_function_type{}(key, 0));
+  std::sort(hashes.begin(), hashes.end());
+  pds::quotient_filter<uint64_t> filter(quotient_bits, std::size_t{8});
+  filter.build_from_sorted(hashes);
+  shared_filter = std::make_unique<filter_type>(std::move(filter));
+}
+void make_locked_filter(const benchmark::State &) {
+  shared_locked_filter = std::make_unique<locked_filter>();
+}
+void drop_locked_filter(const benchmark::State &) {
+  shared_locked_filter.reset();
+}
+
+}  // namespace
+
+// Aggregate insert throughput of one shared filter from 1 to N threads.
+static void BM_concurrent_quotient_filter_insert(benchmark::State &state) {
+  const uint64_t first = uint64_t(state.thread_index()) << 40;
+  const uint64_t lag = window(state);
+  uint64_t key = first;
+  for (auto _ : state) {
+    shared_filter->insert(key);
+    if (key - first >= lag) shared_filter->erase(key - lag);
+    ++key;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_concurrent_quotient_filter_insert)
+    ->Setup(make_shared_filter)
+    ->Teardown(drop_shared_filter)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+
+// The same through an inserter, which buffers keys of busy regions.
+static void BM_concurrent_quotient_filter_inserter(benchmark::State &state) {
+  const uint64_t first = uint64_t(state.thread_index()) << 40;
+  const uint64_t lag = window(state);
+  filter_type::inserter inserter(*shared_filter);
+  uint64_t key = first;
+  for (auto _ : state) {
+    // Flushing every lag keys inserts each before it is erased.
+    if ((key - first) % lag == 0) inserter.flush();
+    inserter.insert(key);
+    if (key - first >= lag) shared_filter->erase(key - lag);
+    ++key;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_concurrent_quotient_filter_inserter)
+    ->Setup(make_shared_filter)
+    ->Teardown(drop_shared_filter)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+
+static void BM_locked_quotient_filter_insert(benchmark::State &state) {
+  const uint64_t first = uint64_t(state.thread_index()) << 40;
+  const uint64_t lag = window(state);
+  uint64_t key = first;
+  for (auto _ : state) {
+    std::lock_guard lock(shared_locked_filter->mutex);
+    shared_locked_filter->filter.insert(key);
+    if (key - first >= lag) shared_locked_filter->filter.erase(key - lag);
+    ++key;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_locked_quotient_filter_insert)
+    ->Setup(make_locked_filter)
+    ->Teardown(drop_locked_filter)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+
+// Lookups alternating between members and non-members.
+static void BM_concurrent_quotient_filter_contains(benchmark::State &state) {
+  uint64_t i = uint64_t(state.thread_index()) << 32;
+  std::size_t hits = 0;
+  for (auto _ : state) {
+    const uint64_t j = i++;
+    hits += shared_filter->contains(j & 1 ? (j * 7919) % filled_keys
+                                          : filled_keys + j);
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_concurrent_quotient_filter_contains)
+    ->Setup(make_filled_filter)
+    ->Teardown(drop_shared_filter)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
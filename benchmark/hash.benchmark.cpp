@@ -0,0 +1,27 @@
+#include "hash.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+// Cost of producing all positions of one key as a function of k. The simple
+// generator hashes the key k times, the double hashing generators once.
+template <typename Generator>
+static void BM_hashes_per_key(benchmark::State &state) {
+  Generator generator(state.range(0), std::size_t{1} << 20);
+  uint64_t key = 0, sink = 0;
+  for (auto _ : state) {
+    for (auto h : generator.hashes(key)) sink += h;
+    ++key;
+  }
+  benchmark::DoNotOptimize(sink);
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_hashes_per_key<pds::hash::default_hash_generator<uint64_t>>)
+    ->DenseRange(1, 16, 3);
+BENCHMARK(BM_hashes_per_key<pds::hash::double_hash_generator<uint64_t>>)
+    ->DenseRange(1, 16, 3);
+BENCHMARK(
+    BM_hashes_per_key<pds::hash::enhanced_double_hash_generator<uint64_t>>)
+    ->DenseRange(1, 16, 3);
@@ -0,0 +1,260 @@
+#include "quotient_filter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_keys.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Quotient filters with 2^24 home slots and 8-bit remainders, filled to
+// state.range(0) percent: inserts, lookups alternating between members and
+// non-members, and erase followed by reinsert.
+
+namespace {
+
+using filter_type = pds::quotient_filter<uint64_t>;
+constexpr std::size_t quotient_bits = 24;
+
+std::vector<uint64_t> fill_keys(const benchmark::State &state) {
+  return random_keys(
+      (std::size_t{1} << quotient_bits) * state.range(0) / 100, 1);
+}
+
+}  // namespace
+
+static void BM_quotient_filter_insert(benchmark::State &state) {
+  const auto keys = fill_keys(state);
+  for (auto _ : state) {
+    filter_type filter(quotient_bits, std::size_t{8});
+    filter.insert(keys.begin(), keys.end());
+    benchmark::DoNotOptimize(filter.size());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_quotient_filter_insert)
+    ->Arg(50)
+    ->Arg(90)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_quotient_filter_contains(benchmark::State &state) {
+  const auto keys = fill_keys(state);
+  const auto others = random_keys(1 << 20, 2);
+  filter_type filter(quotient_bits, std::size_t{8});
+  filter.insert(keys.begin(), keys.end());
+  std::size_t i = 0, hits = 0;
+  for (auto _ : state) {
+    const auto j = i++;
+    hits += filter.contains(j & 1 ? keys[(j * 7919) % keys.size()]
+                                  : others[j & ((1 << 20) - 1)]);
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_quotient_filter_contains)->Arg(50)->Arg(90);
+
+static void BM_quotient_filter_erase_insert(benchmark::State &state) {
+  const auto keys = fill_keys(state);
+  filter_type filter(quotient_bits, std::size_t{8});
+  filter.insert(keys.begin(), keys.end());
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const auto key = keys[(i++ * 7919) % keys.size()];
+    filter.erase(key);
+    filter.insert(key);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_quotient_filter_erase_insert)->Arg(50)->Arg(90);
+
+// Doubling a filter in one pass over it, against rebuilding the doubled
+// filter from the keys.
+static void BM_quotient_filter_expand(benchmark::State &state) {
+  const auto keys = fill_keys(state);
+  filter_type full(quotient_bits, std::size_t{8});
+  full.insert(keys.begin(), keys.end());
+  for (auto _ : state) {
+    state.PauseTiming();
+    filter_type filter = full;
+    state.ResumeTiming();
+    filter.expand();
+    benchmark::DoNotOptimize(filter.size());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_quotient_filter_expand)->Arg(90)->Unit(benchmark::kMillisecond);
+
+static void BM_quotient_filter_reinsert(benchmark::State &state) {
+  const auto keys = fill_keys(state);
+  for (auto _ : state) {
+    filter_type filter(quotient_bits + 1, std::size_t{7});
+    filter.insert(keys.begin(), keys.end());
+    benchmark::DoNotOptimize(filter.size());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_quotient_filter_reinsert)
+    ->Arg(90)
+    ->Unit(benchmark::kMillisecond);
+
+// Compaction: building from sorted hashes, and merging two filters of
+// half the keys, in one pass each, against the random inserts of
+// BM_quotient_filter_insert.
+static void BM_quotient_filter_build_from_sorted(benchmark::State &state) {
+  const auto keys = fill_keys(state);
+  std::vector<uint64_t> hashes;
+  hashes.reserve(keys.size());
+  for (auto key : keys)
+    hashes.push_back(static_cast<uint64_t>(
+        filter_type::hash_function_type{}(key, 0)));
+  std::sort(hashes.begin(), hashes.end());
+  for (auto _ : state) {
+    filter_type filter(quotient_bits, std::size_t{8});
+    filter.build_from_sorted(hashes);
+    benchmark::DoNotOptimize(filter.size());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_quotient_filter_build_from_sorted)
+    ->Arg(90)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_quotient_filter_merge(benchmark::State &state) {
+  const auto keys = fill_keys(state);
+  const auto half = keys.begin() + keys.size() / 2;
+  filter_type a(quotient_bits - 1, std::size_t{9}),
+      b(quotient_bits - 1, std::size_t{9});
+  a.insert(keys.begin(), half);
+  b.insert(half, keys.end());
+  for (auto _ : state) {
+    filter_type filter(quotient_bits, std::size_t{8});
+    filter.merge(a, b);
+    benchmark::DoNotOptimize(filter.size());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_quotient_filter_merge)->Arg(90)->Unit(benchmark::kMillisecond);
+
+// Counting a skewed multiset: 2^22 events drawn from 2^20 keys with Zipf
+// exponent 1.1, so most keys are seen once and a few hundreds of thousands
+// of times. The quotient filter is compared with a count-min sketch of the
+// same size and with a hash map, by bytes used and by mean overcount over
+// the keys seen; the time is that of count() over those keys.
+namespace {
+
+struct zipf_multiset {
+  std::vector<uint64_t> events;
+  std::unordered_map<uint64_t, uint64_t> counts;
+};
+
+const zipf_multiset &zipf_events() {
+  static const zipf_multiset data = [] {
+    constexpr std::size_t universe = 1 << 20;
+    std::vector<double> cdf(universe);
+    double total = 0;
+    for (std::size_t i = 0; i < universe; ++i)
+      cdf[i] = total += std::pow(static_cast<double>(i + 1), -1.1);
+    const auto keys = random_keys(universe, 3);
+    std::mt19937_64 rng(4);
+    std::uniform_real_distribution<double> uniform(0, total);
+    zipf_multiset data;
+    data.events.resize(1 << 22);
+    for (auto &event : data.events) {
+      event = keys[std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) -
+                   cdf.begin()];
+      ++data.counts[event];
+    }
+    return data;
+  }();
+  return data;
+}
+
+// Four rows of 32-bit counters, each key counted in one per row.
+class count_min_sketch {
+ public:
+  explicit count_min_sketch(std::size_t bytes)
+      : width_{bytes / sizeof(uint32_t) / depth}, counters_(width_ * depth) {}
+  void insert(uint64_t key) {
+    for (std::size_t row = 0; row < depth; ++row) ++counters_[index(key, row)];
+  }
+  uint64_t count(uint64_t key) const {
+    uint32_t least = ~uint32_t{0};
+    for (std::size_t row = 0; row < depth; ++row)
+      least = std::min(least, counters_[index(key, row)]);
+    return least;
+  }
+  std::size_t size_in_bytes() const { return counters_.size() * 4; }
+
+ private:
+  static constexpr std::size_t depth = 4;
+  std::size_t index(uint64_t key, std::size_t row) const {
+    const auto h =
+        pds::hash::murmer3_x64_128<uint64_t>{}(key, static_cast<uint32_t>(row));
+    return row * width_ + pds::hash::fast_range<uint64_t>{}(h, width_);
+  }
+  std::size_t width_;
+  std::vector<uint32_t> counters_;
+};
+
+template <typename Counter>
+void count_distinct_keys(benchmark::State &state, const Counter &counter,
+                         std::size_t bytes) {
+  const auto &data = zipf_events();
+  double overcount = 0;
+  for (const auto &[key, n] : data.counts)
+    overcount += static_cast<double>(counter.count(key) - n);
+  uint64_t sum = 0;
+  for (auto _ : state)
+    for (const auto &[key, n] : data.counts) sum += counter.count(key);
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * data.counts.size());
+  state.counters["bytes"] = static_cast<double>(bytes);
+  state.counters["mean_overcount"] =
+      overcount / static_cast<double>(data.counts.size());
+}
+
+}  // namespace
+
+// Sized for the slots the counts take with 8-bit remainders: one or two for
+// counts of one or two, else two plus a digit per factor of 255.
+static filter_type zipf_filter() {
+  std::size_t slots = 0;
+  for (const auto &[key, n] : zipf_events().counts)
+    slots += n < 3 ? n : 3 + static_cast<std::size_t>(std::log(n) / std::log(255));
+  return filter_type(slots, 1.0 / 256);
+}
+
+static void BM_quotient_filter_count_zipf(benchmark::State &state) {
+  const auto &data = zipf_events();
+  auto filter = zipf_filter();
+  for (auto event : data.events) filter.insert(event);
+  count_distinct_keys(state, filter, filter.size_in_bytes());
+}
+static void BM_count_min_count_zipf(benchmark::State &state) {
+  const auto &data = zipf_events();
+  count_min_sketch sketch(zipf_filter().size_in_bytes());
+  for (auto event : data.events) sketch.insert(event);
+  count_distinct_keys(state, sketch, sketch.size_in_bytes());
+}
+static void BM_hash_map_count_zipf(benchmark::State &state) {
+  const auto &data = zipf_events();
+  struct map_counter {
+    std::unordered_map<uint64_t, uint64_t> map;
+    uint64_t count(uint64_t key) const {
+      const auto it = map.find(key);
+      return it == map.end() ? 0 : it->second;
+    }
+  } counter;
+  for (auto event : data.events) ++counter.map[event];
+  // A pointer per bucket and a node of key, count and link per key.
+  const std::size_t bytes = counter.map.bucket_count() * sizeof(void *) +
+                            counter.map.size() * 3 * sizeof(uint64_t);
+  count_distinct_keys(state, counter, bytes);
+}
+BENCHMARK(BM_quotient_filter_count_zipf)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_count_min_count_zipf)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_hash_map_count_zipf)->Unit(benchmark::kMillisecond);
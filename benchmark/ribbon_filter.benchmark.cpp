@@ -0,0 +1,124 @@
+#include "bloom_filter.hpp"
+#include "ribbon_filter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_keys.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Ribbon filters at a 1% false positive rate on state.range(0) keys, with
+// the space and measured rate of a Bloom filter at the same rate for
+// comparison; the xor and binary fuse filters are measured on the same keys
+// in binary_fuse_filter.benchmark.cpp.
+
+namespace {
+
+template <typename Filter>
+double false_positive_rate(const Filter &filter) {
+  const auto probes = random_keys(1 << 20, 3);
+  std::size_t hits = 0;
+  for (auto key : probes) hits += filter.contains(key);
+  return static_cast<double>(hits) / static_cast<double>(probes.size());
+}
+
+// Sized exactly, as in xor_filter.benchmark.cpp.
+using bloom = pds::bloom_filter<
+    uint64_t,
+    pds::hash::double_hash_generator<uint64_t,
+                                     pds::hash::fast_mod_range<uint64_t>>,
+    std::allocator<unsigned long>, pds::bloom_filter_policy::exact>;
+
+template <std::size_t Width>
+using ribbon = pds::ribbon_filter<uint64_t, Width>;
+
+}  // namespace
+
+template <std::size_t Width>
+static void BM_ribbon_filter_build(benchmark::State &state) {
+  const auto keys = random_keys(state.range(0), 1);
+  const double bits = ribbon<Width>::bits_per_key_for(0.01);
+  std::unique_ptr<ribbon<Width>> filter;
+  for (auto _ : state) {
+    filter = std::make_unique<ribbon<Width>>(keys.begin(), keys.end(), bits);
+    benchmark::DoNotOptimize(filter->size_in_bytes());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+  state.counters["bits_per_key"] = filter->bits_per_key();
+  state.counters["fpr"] = false_positive_rate(*filter);
+}
+BENCHMARK(BM_ribbon_filter_build<64>)
+    ->Arg(1 << 20)
+    ->Arg(1 << 24)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ribbon_filter_build<128>)
+    ->Arg(1 << 20)
+    ->Arg(1 << 24)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ribbon_filter_bloom_reference(benchmark::State &state) {
+  const auto keys = random_keys(state.range(0), 1);
+  bloom bf(keys.size(), 0.01);
+  for (auto _ : state) {
+    bf.insert(keys.begin(), keys.end());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+  state.counters["bits_per_key"] =
+      static_cast<double>(bf.bit_capacity()) / static_cast<double>(keys.size());
+  state.counters["fpr"] = false_positive_rate(bf);
+}
+BENCHMARK(BM_ribbon_filter_bloom_reference)
+    ->Arg(1 << 24)
+    ->Unit(benchmark::kMillisecond);
+
+// Lookups of 16M keys, half of them members, one at a time versus batched,
+// on each instruction set (state.range(0) is a pds::simd::isa).
+template <std::size_t Width>
+static void BM_ribbon_filter_contains(benchmark::State &state) {
+  const auto keys = random_keys(1 << 24, 1);
+  auto probes = random_keys(1 << 20, 2);
+  for (std::size_t i = 0; i < probes.size(); i += 2)
+    probes[i] = keys[(i * 7919) % keys.size()];
+  ribbon<Width> filter(keys.begin(), keys.end(),
+                       ribbon<Width>::bits_per_key_for(0.01));
+  const auto path = static_cast<pds::simd::isa>(state.range(0));
+  if (!pds::simd::supports(path)) state.SkipWithError("unsupported isa");
+  filter.set_isa(path);
+  std::size_t hits = 0;
+  for (auto _ : state)
+    for (auto key : probes) hits += filter.contains(key);
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations() * probes.size());
+}
+template <std::size_t Width>
+static void BM_ribbon_filter_contains_batch(benchmark::State &state) {
+  const auto keys = random_keys(1 << 24, 1);
+  auto probes = random_keys(1 << 20, 2);
+  for (std::size_t i = 0; i < probes.size(); i += 2)
+    probes[i] = keys[(i * 7919) % keys.size()];
+  ribbon<Width> filter(keys.begin(), keys.end(),
+                       ribbon<Width>::bits_per_key_for(0.01));
+  const auto path = static_cast<pds::simd::isa>(state.range(0));
+  if (!pds::simd::supports(path)) state.SkipWithError("unsupported isa");
+  filter.set_isa(path);
+  auto results = std::make_unique<bool[]>(probes.size());
+  std::size_t hits = 0;
+  for (auto _ : state)
+    hits += filter.contains_batch(probes, {results.get(), probes.size()});
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations() * probes.size());
+}
+BENCHMARK(BM_ribbon_filter_contains<64>)
+    ->DenseRange(0, 2)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ribbon_filter_contains_batch<64>)
+    ->DenseRange(0, 2)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ribbon_filter_contains<128>)->Arg(0)->Unit(
+    benchmark::kMillisecond);
+BENCHMARK(BM_ribbon_filter_contains_batch<128>)
+    ->Arg(0)
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,31 @@
+#include "scalable_bloom_filter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Lookups of absent keys, which probe every stage, in a filter grown to
+// state.range(0) stages: stage by stage versus the fused path that hashes
+// once and prefetches all stages up front.
+static void BM_scalable_contains(benchmark::State &state, bool fused) {
+  pds::scalable_options options;
+  options.initial_capacity = 1 << 16;
+  options.false_positive_probability = 0.01;
+  options.fused = fused;
+  pds::scalable_bloom_filter<uint64_t> bf(options);
+  std::mt19937_64 rng(3);
+  while (bf.num_stages() < static_cast<std::size_t>(state.range(0)))
+    bf.insert(rng());
+  std::vector<uint64_t> probes(1 << 16);
+  for (auto &key : probes) key = rng();
+  std::size_t i = 0, hits = 0;
+  for (auto _ : state) {
+    hits += bf.contains(probes[i++ & (probes.size() - 1)]);
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_scalable_contains, per_stage, false)->DenseRange(2, 8, 3);
+BENCHMARK_CAPTURE(BM_scalable_contains, fused, true)->DenseRange(2, 8, 3);
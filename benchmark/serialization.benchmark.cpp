@@ -0,0 +1,54 @@
+#include "serialization.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <sstream>
+#include <vector>
+
+// Checksum throughput; compare against a plain memory copy of the same size to
+// see whether validation keeps up with loading.
+static void BM_crc32c(benchmark::State &state) {
+  std::vector<unsigned char> buf(state.range(0), 0x5a);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(pds::crc32c(buf.data(), buf.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_crc32c)->RangeMultiplier(16)->Range(1 << 12, 1 << 26);
+
+static void BM_crc32c_portable(benchmark::State &state) {
+  std::vector<unsigned char> buf(state.range(0), 0x5a);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(pds::crc32c_portable(buf.data(), buf.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_crc32c_portable)->RangeMultiplier(16)->Range(1 << 12, 1 << 26);
+
+static void BM_memcpy(benchmark::State &state) {
+  std::vector<unsigned char> src(state.range(0), 0x5a), dst(state.range(0));
+  for (auto _ : state) {
+    std::memcpy(dst.data(), src.data(), src.size());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_memcpy)->RangeMultiplier(16)->Range(1 << 12, 1 << 26);
+
+// Full load of a saved filter with num_bits bits from an in-memory stream.
+static void BM_load(benchmark::State &state) {
+  pds::bloom_filter<uint64_t> bf(static_cast<std::size_t>(state.range(0)),
+                                 std::size_t{4});
+  for (uint64_t i = 0; i < 100000; ++i) bf.insert(i);
+  std::stringstream ss;
+  pds::serialization::save(ss, bf);
+  const auto bytes = ss.str();
+  for (auto _ : state) {
+    std::istringstream is(bytes);
+    benchmark::DoNotOptimize(
+        pds::serialization::load<pds::bloom_filter<uint64_t>>(is));
+  }
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_load)->RangeMultiplier(8)->Range(1 << 20, 1 << 29);
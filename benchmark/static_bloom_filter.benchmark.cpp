@@ -0,0 +1,72 @@
+#include "static_bloom_filter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "bloom_filter.hpp"
+
+// Small, cache resident filters (4096 bits, 7 hashes): compile-time geometry
+// versus bloom_filter with the same hashing (double hashing on one 128-bit
+// MurmurHash3) and the runtime size and hash count.
+namespace {
+
+constexpr std::size_t small_bits = 4096;
+constexpr std::size_t small_k = 7;
+
+std::vector<uint64_t> small_keys() {
+  std::mt19937_64 rng(5);
+  std::vector<uint64_t> keys(1024);
+  for (auto &key : keys) key = rng();
+  return keys;
+}
+
+}  // namespace
+
+static void BM_static_bloom_filter_contains(benchmark::State &state) {
+  const auto keys = small_keys();
+  pds::static_bloom_filter<uint64_t, small_bits, small_k> bf;
+  for (std::size_t i = 0; i < keys.size(); i += 4) bf.insert(keys[i]);
+  std::size_t i = 0, hits = 0;
+  for (auto _ : state) hits += bf.contains(keys[i++ & (keys.size() - 1)]);
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+static void BM_runtime_bloom_filter_contains(benchmark::State &state) {
+  const auto keys = small_keys();
+  pds::bloom_filter<uint64_t, pds::hash::double_hash_generator<uint64_t>> bf(
+      small_bits, small_k);
+  for (std::size_t i = 0; i < keys.size(); i += 4) bf.insert(keys[i]);
+  std::size_t i = 0, hits = 0;
+  for (auto _ : state) hits += bf.contains(keys[i++ & (keys.size() - 1)]);
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_static_bloom_filter_contains);
+BENCHMARK(BM_runtime_bloom_filter_contains);
+
+static void BM_static_bloom_filter_insert(benchmark::State &state) {
+  const auto keys = small_keys();
+  pds::static_bloom_filter<uint64_t, small_bits, small_k> bf;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    bf.insert(keys[i++ & (keys.size() - 1)]);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+static void BM_runtime_bloom_filter_insert(benchmark::State &state) {
+  const auto keys = small_keys();
+  pds::bloom_filter<uint64_t, pds::hash::double_hash_generator<uint64_t>> bf(
+      small_bits, small_k);
+  std::size_t i = 0;
+  for (auto _ : state) {
+    bf.insert(keys[i++ & (keys.size() - 1)]);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_static_bloom_filter_insert);
+BENCHMARK(BM_runtime_bloom_filter_insert);
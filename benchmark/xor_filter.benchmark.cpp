@@ -0,0 +1,83 @@
+#include "bloom_filter.hpp"
+#include "xor_filter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_keys.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Xor filters against Bloom filters sized for the same false positive
+// probability (2^-8 and 2^-16), on 8M keys, so that both exceed the last
+// level cache. Lookups alternate between members and non-members.
+
+namespace {
+
+constexpr std::size_t xor_bench_keys = std::size_t{1} << 23;
+
+// Sized exactly rather than to a power of two, so that it takes the bits per
+// key the formula asks for.
+using bloom = pds::bloom_filter<
+    uint64_t,
+    pds::hash::double_hash_generator<uint64_t,
+                                     pds::hash::fast_mod_range<uint64_t>>,
+    std::allocator<unsigned long>, pds::bloom_filter_policy::exact>;
+
+template <typename Filter>
+void lookups(benchmark::State &state, const Filter &filter,
+             std::size_t size_in_bytes) {
+  const auto members = random_keys(xor_bench_keys, 1);
+  const auto others = random_keys(1 << 20, 2);
+  std::size_t i = 0, hits = 0;
+  for (auto _ : state) {
+    const auto j = i++;
+    hits += filter.contains(j & 1 ? members[(j * 7919) & (xor_bench_keys - 1)]
+                                  : others[j & ((1 << 20) - 1)]);
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bits_per_key"] =
+      8.0 * static_cast<double>(size_in_bytes) / xor_bench_keys;
+}
+
+}  // namespace
+
+template <typename Fingerprint>
+static void BM_xor_filter_contains(benchmark::State &state) {
+  const auto keys = random_keys(xor_bench_keys, 1);
+  pds::xor_filter<uint64_t, Fingerprint> filter(keys.begin(), keys.end());
+  lookups(state, filter, filter.size_in_bytes());
+}
+static void BM_xor_filter_bloom_contains(benchmark::State &state) {
+  const auto keys = random_keys(xor_bench_keys, 1);
+  bloom filter(keys.size(), 1.0 / static_cast<double>(state.range(0)));
+  filter.insert(keys.begin(), keys.end());
+  lookups(state, filter, filter.bit_capacity() / 8);
+}
+BENCHMARK(BM_xor_filter_contains<uint8_t>);
+BENCHMARK(BM_xor_filter_bloom_contains)->Arg(1 << 8);
+BENCHMARK(BM_xor_filter_contains<uint16_t>);
+BENCHMARK(BM_xor_filter_bloom_contains)->Arg(1 << 16);
+
+template <typename Fingerprint>
+static void BM_xor_filter_build(benchmark::State &state) {
+  const auto keys = random_keys(xor_bench_keys, 1);
+  for (auto _ : state) {
+    pds::xor_filter<uint64_t, Fingerprint> filter(keys.begin(), keys.end());
+    benchmark::DoNotOptimize(filter.seed());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+static void BM_xor_filter_bloom_build(benchmark::State &state) {
+  const auto keys = random_keys(xor_bench_keys, 1);
+  for (auto _ : state) {
+    bloom filter(keys.size(), 1.0 / 256);
+    filter.insert(keys.begin(), keys.end());
+    benchmark::DoNotOptimize(filter.data().data());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_xor_filter_build<uint8_t>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_xor_filter_bloom_build)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,327 @@
+#ifndef PDS_BINARY_FUSE_FILTER_HPP
+#define PDS_BINARY_FUSE_FILTER_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "hash.hpp"
+#include "parallel_build.hpp"
+#include "xor_filter.hpp"
+
+// Binary fuse filter (Graf and Lemire, "Binary Fuse Filters: Fast and Smaller
+// Than Xor Filters"). Like an xor filter, a key's fingerprint is the xor of
+// the fingerprints in Arity slots, but the slots lie in Arity consecutive
+// segments of a power of two length starting at a segment chosen by the
+// hash. The array only needs about 1.125 n (3-wise) or 1.075 n (4-wise)
+// slots, and a lookup touches Arity nearby cache lines.
+//
+// Construction bucket-sorts the key hashes by their first segment, so the
+// slots are filled and peeled roughly front to back and the working set stays
+// a few segments wide instead of the whole array. Keys given by random access
+// iterators are hashed on several threads.
+
+namespace pds {
+
+namespace binary_fuse_detail {
+
+inline std::uint64_t mulhi(std::uint64_t a, std::uint64_t b) noexcept {
+  return static_cast<std::uint64_t>(
+      (static_cast<unsigned __int128>(a) * b) >> 64);
+}
+
+// Segment length and array size factor tuned in the paper, for n keys.
+inline std::uint32_t segment_length(std::size_t arity, std::size_t n) noexcept {
+  if (n < 2) return 4;
+  const double exponent =
+      arity == 3 ? std::log(static_cast<double>(n)) / std::log(3.33) + 2.25
+                 : std::log(static_cast<double>(n)) / std::log(2.91) - 0.5;
+  return std::uint32_t{1} << std::clamp(static_cast<int>(exponent), 0, 18);
+}
+inline double size_factor(std::size_t arity, std::size_t n) noexcept {
+  if (n < 2) return 0.0;
+  const double log_n = std::log(static_cast<double>(n));
+  return arity == 3
+             ? std::max(1.125, 0.875 + 0.25 * std::log(1e6) / log_n)
+             : std::max(1.075, 0.77 + 0.305 * std::log(600000.0) / log_n);
+}
+
+}  // namespace binary_fuse_detail
+
+template <typename Key, std::unsigned_integral Fingerprint = std::uint8_t,
+          std::size_t Arity = 3,
+          hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>,
+          typename Allocator = std::allocator<Fingerprint>>
+class binary_fuse_filter
+    : public xor_detail::hashed_lookup<
+          binary_fuse_filter<Key, Fingerprint, Arity, Hash, Allocator>, Key,
+          Hash> {
+  static_assert(Arity == 3 || Arity == 4);
+
+ public:
+  using key_type = Key;
+  using fingerprint_type = Fingerprint;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using hash_function_type = Hash;
+
+  static_assert(std::numeric_limits<typename Hash::hash_type>::digits >= 64,
+                "binary fuse filters need a 64-bit hash");
+
+  static constexpr size_type fingerprint_bits =
+      std::numeric_limits<Fingerprint>::digits;
+  static constexpr size_type hashes_per_key = Arity;
+  static constexpr unsigned max_attempts = 64;
+
+  static constexpr double false_positive_probability() noexcept {
+    return 1.0 / static_cast<double>(std::uint64_t{1} << fingerprint_bits);
+  }
+
+  // Builds the filter from the keys in [first, last), hashing them with
+  // num_threads threads if the iterators are random access. Duplicate keys
+  // are allowed. Throws std::length_error above 2^32 slots and
+  // std::runtime_error if no seed leads to a successful peel, which with
+  // distinct keys does not happen in practice.
+  template <std::forward_iterator It>
+  binary_fuse_filter(It first, It last, const Allocator &alloc = Allocator())
+      : binary_fuse_filter(first, last, parallel_build::default_threads(),
+                           alloc) {}
+  template <std::forward_iterator It>
+  binary_fuse_filter(It first, It last, unsigned num_threads,
+                     const Allocator &alloc = Allocator())
+      : fingerprints_(alloc) {
+    const auto n = static_cast<size_type>(std::distance(first, last));
+    set_geometry(n);
+    using hash_allocator = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<std::uint64_t>;
+    std::vector<std::uint64_t, hash_allocator> hashes(n, hash_allocator{alloc});
+    hash_keys(first, n, hashes.data(), num_threads);
+    build(hashes, alloc);
+  }
+  explicit binary_fuse_filter(std::span<const Key> keys,
+                              const Allocator &alloc = Allocator())
+      : binary_fuse_filter(keys.begin(), keys.end(), alloc) {}
+
+  bool contains_hash(std::uint64_t key_hash) const noexcept {
+    const std::uint64_t h = xor_detail::mix(key_hash + seed_);
+    Fingerprint f = xor_detail::fingerprint<Fingerprint>(h);
+    for (auto slot : slots(h)) f ^= fingerprints_[slot];
+    return f == 0;
+  }
+
+  // Number of distinct key hashes the filter was built from.
+  size_type size() const noexcept { return size_; }
+  size_type num_slots() const noexcept { return fingerprints_.size(); }
+  size_type size_in_bytes() const noexcept {
+    return fingerprints_.size() * sizeof(Fingerprint);
+  }
+  double bits_per_key() const noexcept {
+    return size_ ? 8.0 * static_cast<double>(size_in_bytes()) /
+                       static_cast<double>(size_)
+                 : 0.0;
+  }
+  std::uint32_t segment_length() const noexcept { return segment_length_; }
+  std::uint64_t seed() const noexcept { return seed_; }
+  // The slots of a key, one in each of Arity consecutive segments.
+  std::array<std::uint32_t, Arity> key_slots(const Key &key) const noexcept {
+    return slots(xor_detail::mix(this->hash_key(key) + seed_));
+  }
+
+ private:
+  // Sets the geometry for n keys.
+  void set_geometry(size_type n) {
+    segment_length_ = binary_fuse_detail::segment_length(Arity, n);
+    const auto capacity = static_cast<size_type>(std::round(
+        static_cast<double>(n) * binary_fuse_detail::size_factor(Arity, n)));
+    const size_type segments =
+        (capacity + segment_length_ - 1) / segment_length_;
+    segment_count_ = segments <= Arity - 1 ? 1 : segments - (Arity - 1);
+    const size_type array_length =
+        (segment_count_ + Arity - 1) * size_type{segment_length_};
+    if (array_length > std::numeric_limits<std::uint32_t>::max())
+      throw std::length_error("binary_fuse_filter: too many keys");
+    fingerprints_.assign(array_length, 0);
+  }
+
+  // Slot j lies in segment first + j, where the first segment is chosen by
+  // the high bits of h and the offsets within segments by disjoint bit
+  // ranges of it.
+  std::array<std::uint32_t, Arity> slots(std::uint64_t h) const noexcept {
+    const std::uint32_t mask = segment_length_ - 1;
+    const auto first = static_cast<std::uint32_t>(binary_fuse_detail::mulhi(
+        h, std::uint64_t{segment_count_} * segment_length_));
+    std::array<std::uint32_t, Arity> s;
+    s[0] = first;
+    s[1] = (first + segment_length_) ^
+           (static_cast<std::uint32_t>(h >> 18) & mask);
+    s[2] = (first + 2 * segment_length_) ^
+           (static_cast<std::uint32_t>(h) & mask);
+    if constexpr (Arity == 4)
+      s[3] = (first + 3 * segment_length_) ^
+             (static_cast<std::uint32_t>(h >> 36) & mask);
+    return s;
+  }
+
+  template <typename It>
+  static void hash_keys(It first, size_type n, std::uint64_t *out,
+                        unsigned num_threads) {
+    auto hash_range = [&](size_type begin, size_type end) {
+      auto it = std::next(first, static_cast<std::ptrdiff_t>(begin));
+      for (size_type i = begin; i < end; ++i, ++it)
+        out[i] = binary_fuse_filter::hash_key(*it);
+    };
+    if constexpr (std::random_access_iterator<It>) {
+      num_threads = static_cast<unsigned>(std::clamp<size_type>(
+          num_threads, 1,
+          std::max<size_type>(1, n / parallel_build::min_keys_per_thread)));
+      if (num_threads > 1) {
+        const size_type per_thread = (n + num_threads - 1) / num_threads;
+        std::vector<std::jthread> threads;
+        for (unsigned t = 1; t < num_threads; ++t)
+          threads.emplace_back(hash_range, std::min(n, t * per_thread),
+                               std::min(n, (t + 1) * per_thread));
+        hash_range(0, std::min(n, per_thread));
+        return;
+      }
+    }
+    hash_range(0, n);
+  }
+
+  template <typename HashVector>
+  void build(HashVector &hashes, const Allocator &alloc) {
+    using rebind = std::allocator_traits<Allocator>;
+    using u8_allocator = typename rebind::template rebind_alloc<std::uint8_t>;
+    using u32_allocator = typename rebind::template rebind_alloc<std::uint32_t>;
+    using u64_allocator = typename rebind::template rebind_alloc<std::uint64_t>;
+    const size_type array_length = fingerprints_.size();
+    // Construction state of a slot: the xor of the hashes of the keys mapping
+    // to it, their number (count_which >> 2) and the xor of the slot's
+    // position among each key's slots (count_which & 3). Once one key is
+    // left, these name the key and which of its slots this is. Nine bytes a
+    // slot keep a window of a few segments in cache.
+    std::vector<std::uint64_t, u64_allocator> xor_hash(array_length,
+                                                       u64_allocator{alloc});
+    std::vector<std::uint8_t, u8_allocator> count_which(array_length,
+                                                        u8_allocator{alloc});
+    std::vector<std::uint32_t, u32_allocator> queue(u32_allocator{alloc});
+    // Mixed hashes in bucket order; reused for the peeled keys in order.
+    std::vector<std::uint64_t, u64_allocator> order(hashes.size(),
+                                                    u64_allocator{alloc});
+    // For each peeled key, which of its slots it was peeled from.
+    std::vector<std::uint8_t, u8_allocator> which(hashes.size(),
+                                                  u8_allocator{alloc});
+    // Buckets by the top bucket_bits bits of the mixed hash, at least one
+    // per segment. The first slot grows with the hash, so bucket order is
+    // slot order up to the width of a bucket.
+    const int bucket_bits =
+        std::bit_width(std::max<size_type>(segment_count_, 2) - 1);
+    std::vector<std::uint64_t, u64_allocator> bucket_start(
+        (size_type{1} << bucket_bits) + 1, u64_allocator{alloc});
+    const auto bucket = [bucket_bits](std::uint64_t h) {
+      return h >> (64 - bucket_bits);
+    };
+
+    for (unsigned attempt = 0; attempt < max_attempts; ++attempt) {
+      // Equal key hashes map to equal slots and can never be peeled, so
+      // after two failures assume duplicates and drop them.
+      if (attempt == 2) {
+        std::sort(hashes.begin(), hashes.end());
+        hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+      }
+      const size_type n = hashes.size();
+      seed_ = xor_detail::attempt_seed(attempt);
+
+      std::fill(bucket_start.begin(), bucket_start.end(), 0);
+      for (auto key_hash : hashes)
+        ++bucket_start[bucket(xor_detail::mix(key_hash + seed_)) + 1];
+      for (size_type b = 1; b < bucket_start.size(); ++b)
+        bucket_start[b] += bucket_start[b - 1];
+      for (auto key_hash : hashes) {
+        const std::uint64_t h = xor_detail::mix(key_hash + seed_);
+        order[bucket_start[bucket(h)]++] = h;
+      }
+
+      std::fill(xor_hash.begin(), xor_hash.end(), 0);
+      std::fill(count_which.begin(), count_which.end(), 0);
+      bool overflow = false;
+      for (size_type i = 0; i < n; ++i) {
+        const std::uint64_t h = order[i];
+        const auto s = slots(h);
+        for (std::uint32_t j = 0; j < Arity; ++j) {
+          xor_hash[s[j]] ^= h;
+          count_which[s[j]] = static_cast<std::uint8_t>(
+              (count_which[s[j]] + 4) ^ j);
+          // More than 63 keys on one slot means duplicates.
+          overflow |= count_which[s[j]] < 4;
+        }
+      }
+      if (overflow) continue;
+
+      // Peels while scanning: every singleton found is drained together with
+      // the singletons it creates, which lie within a few segments of it, so
+      // the peel follows the scan front to back and the queue stays short.
+      size_type peeled = 0;
+      for (std::uint32_t i = 0; i < array_length; ++i) {
+        if ((count_which[i] >> 2) != 1) continue;
+        queue.push_back(i);
+        while (!queue.empty()) {
+          const std::uint32_t slot = queue.back();
+          queue.pop_back();
+          if ((count_which[slot] >> 2) != 1) continue;
+          const std::uint64_t h = xor_hash[slot];
+          const auto s = slots(h);
+          order[peeled] = h;
+          which[peeled++] = count_which[slot] & 3;
+          for (std::uint32_t j = 0; j < Arity; ++j) {
+            xor_hash[s[j]] ^= h;
+            count_which[s[j]] =
+                static_cast<std::uint8_t>((count_which[s[j]] - 4) ^ j);
+            if ((count_which[s[j]] >> 2) == 1) queue.push_back(s[j]);
+          }
+        }
+      }
+      if (peeled != n) continue;
+
+      // Assign in reverse peel order: each key's slot is the last of its
+      // slots to be written, so it can absorb the others.
+      std::fill(fingerprints_.begin(), fingerprints_.end(), 0);
+      for (size_type i = n; i-- > 0;) {
+        const std::uint64_t h = order[i];
+        const auto s = slots(h);
+        Fingerprint f = xor_detail::fingerprint<Fingerprint>(h);
+        for (auto slot : s) f ^= fingerprints_[slot];
+        fingerprints_[s[which[i]]] = f;
+      }
+      size_ = n;
+      return;
+    }
+    throw std::runtime_error("binary_fuse_filter: construction failed");
+  }
+
+  std::vector<Fingerprint, Allocator> fingerprints_;
+  std::uint32_t segment_length_ = 0;
+  std::uint32_t segment_count_ = 0;
+  std::uint64_t seed_ = 0;
+  size_type size_ = 0;
+};
+
+template <typename Key, std::size_t Arity = 3,
+          hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>>
+using binary_fuse8_filter = binary_fuse_filter<Key, std::uint8_t, Arity, Hash>;
+template <typename Key, std::size_t Arity = 3,
+          hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>>
+using binary_fuse16_filter =
+    binary_fuse_filter<Key, std::uint16_t, Arity, Hash>;
+
+}  // namespace pds
+#endif
@@ -0,0 +1,145 @@
+#ifndef PDS_BIT_KERNELS_HPP
+#define PDS_BIT_KERNELS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+
+#include "libpopcnt.h"
+#include "simd.hpp"
+
+// Bulk kernels over word arrays, used for filter union, intersection and
+// fill counting. These are bound by memory bandwidth, so the vector paths only
+// need to keep loads wide and the loop overhead negligible; the N-way
+// reduction additionally keeps the destination in L1 while every input is
+// streamed through it exactly once.
+
+namespace pds {
+namespace simd {
+
+using word = unsigned long;
+
+struct bit_or {
+  word operator()(word a, word b) const noexcept { return a | b; }
+#if PDS_X86_DISPATCH
+  PDS_TARGET("avx2") __m256i operator()(__m256i a, __m256i b) const noexcept {
+    return _mm256_or_si256(a, b);
+  }
+  PDS_TARGET("avx512f") __m512i operator()(__m512i a, __m512i b) const noexcept {
+    return _mm512_or_si512(a, b);
+  }
+#endif
+};
+
+struct bit_and {
+  word operator()(word a, word b) const noexcept { return a & b; }
+#if PDS_X86_DISPATCH
+  PDS_TARGET("avx2") __m256i operator()(__m256i a, __m256i b) const noexcept {
+    return _mm256_and_si256(a, b);
+  }
+  PDS_TARGET("avx512f") __m512i operator()(__m512i a, __m512i b) const noexcept {
+    return _mm512_and_si512(a, b);
+  }
+#endif
+};
+
+namespace kernel_detail {
+
+template <typename Op>
+void apply_scalar(word *dst, const word *a, const word *b,
+                  std::size_t n) noexcept {
+  for (std::size_t i = 0; i < n; ++i) dst[i] = Op{}(a[i], b[i]);
+}
+
+#if PDS_X86_DISPATCH
+template <typename Op>
+PDS_TARGET("avx2")
+void apply_avx2(word *dst, const word *a, const word *b,
+                std::size_t n) noexcept {
+  constexpr std::size_t step = 4 * sizeof(__m256i) / sizeof(word);
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    const auto *va = reinterpret_cast<const __m256i *>(a + i);
+    const auto *vb = reinterpret_cast<const __m256i *>(b + i);
+    auto *vd = reinterpret_cast<__m256i *>(dst + i);
+    const __m256i r0 = Op{}(_mm256_loadu_si256(va), _mm256_loadu_si256(vb));
+    const __m256i r1 =
+        Op{}(_mm256_loadu_si256(va + 1), _mm256_loadu_si256(vb + 1));
+    const __m256i r2 =
+        Op{}(_mm256_loadu_si256(va + 2), _mm256_loadu_si256(vb + 2));
+    const __m256i r3 =
+        Op{}(_mm256_loadu_si256(va + 3), _mm256_loadu_si256(vb + 3));
+    _mm256_storeu_si256(vd, r0);
+    _mm256_storeu_si256(vd + 1, r1);
+    _mm256_storeu_si256(vd + 2, r2);
+    _mm256_storeu_si256(vd + 3, r3);
+  }
+  for (; i < n; ++i) dst[i] = Op{}(a[i], b[i]);
+}
+
+template <typename Op>
+PDS_TARGET("avx512f")
+void apply_avx512(word *dst, const word *a, const word *b,
+                  std::size_t n) noexcept {
+  constexpr std::size_t step = 2 * sizeof(__m512i) / sizeof(word);
+  std::size_t i = 0;
+  for (; i + step <= n; i += step) {
+    const __m512i r0 = Op{}(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+    const __m512i r1 = Op{}(_mm512_loadu_si512(a + i + step / 2),
+                            _mm512_loadu_si512(b + i + step / 2));
+    _mm512_storeu_si512(dst + i, r0);
+    _mm512_storeu_si512(dst + i + step / 2, r1);
+  }
+  for (; i < n; ++i) dst[i] = Op{}(a[i], b[i]);
+}
+#endif
+
+}  // namespace kernel_detail
+
+// dst[i] = Op(a[i], b[i]) for i < n. dst may alias a or b.
+template <typename Op>
+void apply(word *dst, const word *a, const word *b, std::size_t n,
+           isa target = best_isa()) noexcept {
+#if PDS_X86_DISPATCH
+  switch (target) {
+    case isa::avx512:
+      return kernel_detail::apply_avx512<Op>(dst, a, b, n);
+    case isa::avx2:
+      return kernel_detail::apply_avx2<Op>(dst, a, b, n);
+    case isa::scalar:
+      break;
+  }
+#else
+  (void)target;
+#endif
+  kernel_detail::apply_scalar<Op>(dst, a, b, n);
+}
+
+// Number of set bits in the given bytes, using libpopcnt's Harley-Seal AVX2
+// or AVX-512 VPOPCNTDQ kernels where the CPU has them.
+inline std::size_t popcount_bytes(const void *data, std::size_t bytes) noexcept {
+  return static_cast<std::size_t>(::popcnt(data, bytes));
+}
+inline std::size_t popcount(const word *data, std::size_t n) noexcept {
+  return popcount_bytes(data, n * sizeof(word));
+}
+
+// Words per step of reduce: 8 KiB of destination stays in L1 while every
+// source passes over it.
+inline constexpr std::size_t reduce_chunk_words = 1024;
+
+// dst[i] = Op(dst[i], sources[0][i], ..., sources[m-1][i]) for i < n.
+template <typename Op>
+void reduce(word *dst, std::span<const word *const> sources, std::size_t n,
+            isa target = best_isa()) noexcept {
+  for (std::size_t offset = 0; offset < n; offset += reduce_chunk_words) {
+    const std::size_t len = std::min(reduce_chunk_words, n - offset);
+    for (const word *source : sources) {
+      apply<Op>(dst + offset, dst + offset, source + offset, len, target);
+    }
+  }
+}
+
+}  // namespace simd
+}  // namespace pds
+#endif
@@ -1,13 +1,26 @@
 #ifndef PDS_BLOOM_FILTER_HPP
 #define PDS_BLOOM_FILTER_HPP
 
+#include <algorithm>
 #include <bit>
-#include <ranges>
+#include <cassert>
+#include <cmath>
 #include <concepts>
 #include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <stdexcept>
 #include <vector>
 
+#include <sul/dynamic_bitset.hpp>
+
+#include "bit_kernels.hpp"
 #include "hash.hpp"
+#include "parallel_build.hpp"
+#include "simd.hpp"
 // use fastrange for faster modulo or libdivide,
 // Options for prime number and power-of-2 sized bitvectors. Apparently you want
 // to mod a hash by a prime. use chache local HashGenerator, use SIMD
@@ -129,25 +142,35 @@ namespace pds {
     };
   }
 
+// With TrackSetBits the number of set bits is maintained on every insert, so
+// num_set_bits, approximate_cardinality and approximate_fpp are O(1) instead
+// of a scan of the whole array. Inserts pay a compare per hash for it.
 template <typename Key,
           hash::HashGenerator<Key> HashGen =
               pds::hash::default_hash_generator<Key>,
           typename Allocator = std::allocator<unsigned long>, bloom_filter_policy::SizingPolicy SizingPolicy =
-              bloom_filter_policy::power_of_two>
+              bloom_filter_policy::power_of_two,
+          bool TrackSetBits = false>
 class bloom_filter {
-  using word_type = unsigned long;
  public:
+  using word_type = unsigned long;
   using key_type = Key;
   using hash_type = HashGen::hash_type;
   using size_type = std::size_t;
   using allocator_type = Allocator;
   using hash_generator_type = HashGen;
+  static constexpr bool tracks_set_bits = TrackSetBits;
 
   static constexpr size_type bits_per_word =
       std::numeric_limits<word_type>::digits;
   static constexpr size_type bits_per_word_log2 =
       std::countr_zero(bits_per_word);
   static constexpr size_type word_mask = bits_per_word-1u;
+  // Number of keys hashed ahead of the probe in the batched operations.
+  static constexpr size_type batch_window = 16;
+  // The batched operations keep their ring of positions on the stack and go
+  // key by key for larger k.
+  static constexpr size_type max_batch_hashes = 32;
 
   static constexpr std::size_t optimal_num_bits(std::size_t input_size,
                                            double false_positive_probability) {
@@ -190,6 +213,16 @@ class bloom_filter {
                const Allocator &alloc = Allocator())
       : num_bits_{hash_generator.range()}, bit_array_((num_bits_ + bits_per_word - 1) / bits_per_word, 0, alloc),
         hash_generator_(std::move(hash_generator)) {}
+  // Adopts an existing bit array laid out like data(), e.g. one produced by
+  // counting_bloom_filter::to_bloom_filter or read from disk.
+  bloom_filter(HashGen hash_generator,
+               std::vector<word_type, allocator_type> bit_array)
+      : num_bits_{hash_generator.range()}, bit_array_(std::move(bit_array)),
+        hash_generator_(std::move(hash_generator)) {
+    assert(bit_array_.size() ==
+           (num_bits_ + bits_per_word - 1) / bits_per_word);
+    recount();
+  }
 
   template <typename InputIt>
   void insert(InputIt first, InputIt last) noexcept {
@@ -198,28 +231,156 @@ class bloom_filter {
     }
   }
   void insert(const Key &key) noexcept {
-    for (auto hash : hash_generator_.hashes(key)) {
-      bit_array_[hash >> bits_per_word_log2] |= 1
-                                                     << (hash & word_mask);
-    }
+    for (auto hash : hash_generator_.hashes(key)) set_bit(hash);
   }
   bool contains(const Key &key) const noexcept {
-    for (auto hash : hash_generator_.hashes(key)) {
-      if (!(bit_array_[hash >> bits_per_word_log2] &
-            (1 << (hash & word_mask))))
-        return false;
+    return test_bits(hash_generator_.hashes(key));
+  }
+  template <hash::TransparentKey<Key> K>
+    requires requires(const HashGen &g, const K &k) { g.hashes(k); }
+  bool contains(const K &key) const noexcept {
+    return test_bits(hash_generator_.hashes(key));
+  }
+
+  // Inserts [first, last) using num_threads threads; see parallel_build.hpp.
+  // The result is identical to insert(first, last).
+  template <std::random_access_iterator It>
+  void insert_parallel(It first, It last,
+                       unsigned num_threads = parallel_build::default_threads()) {
+    parallel_build::set_bits(
+        first, last, num_bits_, hashes_per_key(), num_threads,
+        [this](const Key &key, size_type *out) {
+          std::ranges::copy(hash_generator_.hashes(key), out);
+        },
+        [this](size_type bit) {
+          bit_array_[bit >> bits_per_word_log2] |= word_type{1}
+                                                   << (bit & word_mask);
+        });
+    recount();
+  }
+
+  // Batched operations hash batch_window keys ahead and prefetch their words,
+  // so the cache misses of consecutive keys overlap instead of serializing.
+  void insert_batch(std::span<const Key> keys) noexcept {
+    if (hashes_per_key() > max_batch_hashes) {
+      for (const auto &key : keys) insert(key);
+      return;
     }
-    return true;
+    pipelined(keys, true, [&](size_type, const size_type *positions) {
+      for (size_type j = 0; j < hashes_per_key(); ++j) set_bit(positions[j]);
+    });
+  }
+  // Writes contains(keys[i]) to results[i] and returns the number of hits.
+  std::size_t contains_batch(std::span<const Key> keys,
+                             std::span<bool> results) const noexcept {
+    assert(results.size() >= keys.size());
+    std::size_t hits = 0;
+    if (hashes_per_key() > max_batch_hashes) {
+      for (size_type i = 0; i < keys.size(); ++i)
+        hits += results[i] = contains(keys[i]);
+      return hits;
+    }
+    pipelined(keys, false, [&](size_type i, const size_type *positions) {
+      hits += results[i] = probe(positions);
+    });
+    return hits;
+  }
+  template <typename Block, typename BlockAllocator>
+  std::size_t contains_batch(
+      std::span<const Key> keys,
+      sul::dynamic_bitset<Block, BlockAllocator> &results) const noexcept {
+    assert(results.size() >= keys.size());
+    std::size_t hits = 0;
+    if (hashes_per_key() > max_batch_hashes) {
+      for (size_type i = 0; i < keys.size(); ++i) {
+        const bool hit = contains(keys[i]);
+        results.set(i, hit);
+        hits += hit;
+      }
+      return hits;
+    }
+    pipelined(keys, false, [&](size_type i, const size_type *positions) {
+      const bool hit = probe(positions);
+      results.set(i, hit);
+      hits += hit;
+    });
+    return hits;
+  }
+
+  // Position-level operations for callers that hash keys themselves, e.g. to
+  // share one hash computation between several filters. positions are
+  // generator outputs, i.e. bit indices below bit_capacity().
+  void insert_positions(std::span<const size_type> positions) noexcept {
+    for (auto position : positions) set_bit(position);
+  }
+  bool contains_positions(
+      std::span<const size_type> positions) const noexcept {
+    return test_bits(positions);
+  }
+  void prefetch_positions(std::span<const size_type> positions,
+                          bool for_write = false) const noexcept {
+    for (auto position : positions) {
+      const auto *word = &bit_array_[position >> bits_per_word_log2];
+      if (for_write)
+        simd::prefetch_write(word);
+      else
+        simd::prefetch_read(word);
+    }
+  }
+
+  // Hash once, probe many: prehash(key) computes the hash every position of
+  // key derives from, independent of the filter's size, so a key checked
+  // against many filters (e.g. one per file of an LSM tree) is hashed only
+  // once. Filters sharing a prehashed_key must share the generator's seed.
+  template <hash::KeyLike<Key> K = Key>
+    requires hash::PrehashGenerator<HashGen>
+  hash::prehashed_key prehash(const K &key) const noexcept {
+    return hash_generator_.prehash(key);
+  }
+  void insert_hash(const hash::prehashed_key &key) noexcept
+    requires hash::PrehashGenerator<HashGen>
+  {
+    for (auto hash : hash_generator_.hashes(key)) set_bit(hash);
+  }
+  bool contains_hash(const hash::prehashed_key &key) const noexcept
+    requires hash::PrehashGenerator<HashGen>
+  {
+    return test_bits(hash_generator_.hashes(key));
+  }
+  // Bit i of the result is contains_hash(key) on filters[i]. The first word
+  // of every filter is prefetched before any is tested, so their cache misses
+  // overlap; most lookups in a filter without the key end at that word.
+  static std::uint64_t probe_all(const hash::prehashed_key &key,
+                                 std::span<const bloom_filter> filters) noexcept
+    requires hash::PrehashGenerator<HashGen>
+  {
+    assert(filters.size() <= 64);
+    for (const auto &filter : filters) {
+      auto hashes = filter.hash_generator_.hashes(key);
+      if (auto it = std::ranges::begin(hashes); it != std::ranges::end(hashes))
+        simd::prefetch_read(&filter.bit_array_[*it >> bits_per_word_log2]);
+    }
+    std::uint64_t hits = 0;
+    for (size_type i = 0; i < filters.size(); ++i)
+      hits |= std::uint64_t{filters[i].contains_hash(key)} << i;
+    return hits;
+  }
+
+  void clear() noexcept {
+    std::fill(bit_array_.begin(), bit_array_.end(), 0);
+    set_bits_ = 0;
   }
-  void clear() noexcept { std::fill(bit_array_.begin(), bit_array_.end(), 0); }
 
   // Returns the number of bits.
   std::size_t bit_capacity() const noexcept { return num_bits_; }
 
   // Returns the number of set bits in the underlying bit array.
   std::size_t num_set_bits() const noexcept {
-    auto rv = bit_array_ | std::views::transform(std::popcount<word_type>);
-    return std::accumulate(rv.begin(), rv.end(), 0);
+    if constexpr (TrackSetBits) {
+      return set_bits_;
+    } else {
+      return simd::popcount(bit_array_.data(), bit_array_.size());
+    }
   }
 
   HashGen hash_generator() const noexcept {
@@ -231,8 +392,11 @@ class bloom_filter {
                        [](word_type x) { return x == 0; });
   }
 
-  void swap(bloom_filter<Key, HashGen, Allocator> &other) noexcept {
+  void swap(bloom_filter &other) noexcept {
+    std::swap(num_bits_, other.num_bits_);
+    std::swap(set_bits_, other.set_bits_);
     bit_array_.swap(other.bit_array_);
+    std::swap(hash_generator_, other.hash_generator_);
   }
 
   std::size_t hashes_per_key() const noexcept {
@@ -249,45 +413,130 @@ class bloom_filter {
                                       hashes_per_key());
   }
 
-  const std::vector<word_type> &data() { return bit_array_; }
+  const std::vector<word_type, allocator_type> &data() const noexcept {
+    return bit_array_;
+  }
 
-  bloom_filter<Key, HashGen, Allocator> &operator&=(
-      const bloom_filter<Key, HashGen, Allocator> &other) {
+  // Set algebra. All operands must have the same size and hash generator.
+  bloom_filter &operator&=(const bloom_filter &other) noexcept {
     assert(other.bit_capacity() == bit_capacity());
-    for (std::size_t i = 0; i < bit_array_.size(); ++i) {
-      bit_array_[i] &= other.bit_array_[i];
-    }
+    simd::apply<simd::bit_and>(bit_array_.data(), bit_array_.data(),
+                               other.bit_array_.data(), bit_array_.size());
+    recount();
     return *this;
   }
 
-  bloom_filter<Key, HashGen, Allocator> operator&(
-      const bloom_filter<Key, HashGen, Allocator> &other) {
-    bloom_filter<Key, HashGen, Allocator> res(*this);
-    res &= other;
+  bloom_filter operator&(const bloom_filter &other) const {
+    bloom_filter res(hash_generator_, bit_array_.get_allocator());
+    res.intersect(*this, other);
     return res;
   }
 
-  bloom_filter<Key, HashGen, Allocator> &operator|=(
-      const bloom_filter<Key, HashGen, Allocator> &other) {
+  bloom_filter &operator|=(const bloom_filter &other) noexcept {
     assert(other.bit_capacity() == bit_capacity());
-    for (std::size_t i = 0; i < bit_array_.size(); ++i) {
-      bit_array_[i] |= other.bit_array_[i];
-    }
+    simd::apply<simd::bit_or>(bit_array_.data(), bit_array_.data(),
+                              other.bit_array_.data(), bit_array_.size());
+    recount();
     return *this;
   }
 
-  bloom_filter<Key, HashGen, Allocator> operator|(
-      const bloom_filter<Key, HashGen, Allocator> &other) {
-    bloom_filter<Key, HashGen, Allocator> res(*this);
-    res |= other;
+  bloom_filter operator|(const bloom_filter &other) const {
+    bloom_filter res(hash_generator_, bit_array_.get_allocator());
+    res.unite(*this, other);
     return res;
   }
 
+  // Sets *this to a | b, reusing its storage.
+  bloom_filter &unite(const bloom_filter &a, const bloom_filter &b) noexcept {
+    assert(a.bit_capacity() == bit_capacity() &&
+           b.bit_capacity() == bit_capacity());
+    simd::apply<simd::bit_or>(bit_array_.data(), a.bit_array_.data(),
+                              b.bit_array_.data(), bit_array_.size());
+    recount();
+    return *this;
+  }
+  // Sets *this to a & b, reusing its storage.
+  bloom_filter &intersect(const bloom_filter &a,
+                          const bloom_filter &b) noexcept {
+    assert(a.bit_capacity() == bit_capacity() &&
+           b.bit_capacity() == bit_capacity());
+    simd::apply<simd::bit_and>(bit_array_.data(), a.bit_array_.data(),
+                               b.bit_array_.data(), bit_array_.size());
+    recount();
+    return *this;
+  }
+
+  // ORs every filter into *this. Cheaper than repeated |=: each input is read
+  // once, and *this is read and written once instead of once per input.
+  bloom_filter &merge_all(std::span<const bloom_filter *const> filters) {
+    std::vector<const word_type *> sources;
+    sources.reserve(filters.size());
+    for (const auto *filter : filters) {
+      assert(filter->bit_capacity() == bit_capacity());
+      sources.push_back(filter->bit_array_.data());
+    }
+    simd::reduce<simd::bit_or>(bit_array_.data(), sources, bit_array_.size());
+    recount();
+    return *this;
+  }
+
  private:
+  void set_bit(size_type position) noexcept {
+    auto &word = bit_array_[position >> bits_per_word_log2];
+    const word_type mask = word_type{1} << (position & word_mask);
+    if constexpr (TrackSetBits) set_bits_ += !(word & mask);
+    word |= mask;
+  }
+  // Bulk operations recount rather than track bit by bit.
+  void recount() noexcept {
+    if constexpr (TrackSetBits) {
+      set_bits_ = simd::popcount(bit_array_.data(), bit_array_.size());
+    }
+  }
+
+  template <std::ranges::input_range Positions>
+  bool test_bits(Positions &&positions) const noexcept {
+    for (auto position : positions) {
+      if (!(bit_array_[position >> bits_per_word_log2] &
+            (word_type{1} << (position & word_mask))))
+        return false;
+    }
+    return true;
+  }
+  bool probe(const size_type *positions) const noexcept {
+    return test_bits(std::span{positions, hashes_per_key()});
+  }
+
+  // Hashes key i into a ring of batch_window slots and prefetches its words,
+  // then hands the slot of key i - batch_window to op.
+  template <typename Op>
+  void pipelined(std::span<const Key> keys, bool for_write,
+                 Op &&op) const noexcept {
+    const size_type k = hashes_per_key();
+    assert(k <= max_batch_hashes);
+    size_type ring[batch_window * max_batch_hashes];
+    const size_type n = keys.size();
+    for (size_type i = 0; i < n + batch_window; ++i) {
+      size_type *slot = ring + (i % batch_window) * k;
+      if (i >= batch_window) op(i - batch_window, slot);
+      if (i >= n) continue;
+      size_type j = 0;
+      for (auto hash : hash_generator_.hashes(keys[i])) {
+        slot[j++] = hash;
+        const auto *word = &bit_array_[hash >> bits_per_word_log2];
+        if (for_write)
+          simd::prefetch_write(word);
+        else
+          simd::prefetch_read(word);
+      }
+    }
+  }
+
   std::size_t num_bits_;
   std::vector<word_type, allocator_type> bit_array_;
   hash_generator_type hash_generator_;
-  
+  // Maintained only with TrackSetBits.
+  std::size_t set_bits_ = 0;
 };
 
 }  // namespace pds
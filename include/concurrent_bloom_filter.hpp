@@ -0,0 +1,163 @@
+#ifndef PDS_CONCURRENT_BLOOM_FILTER_HPP
+#define PDS_CONCURRENT_BLOOM_FILTER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "bloom_filter.hpp"
+#include "hash.hpp"
+
+// Bloom filter that many threads can insert into and query at the same time
+// without a lock. Setting a bit is idempotent and commutative, so a relaxed
+// fetch_or per probe is all the synchronisation inserts need, and lookups are
+// plain relaxed loads. A lookup racing with an insert of the same key may miss
+// it; once the inserting thread has synchronised with the reader (e.g. joined)
+// the key is always found.
+
+namespace pds {
+
+template <typename Key,
+          hash::HashGenerator<Key> HashGen =
+              pds::hash::default_hash_generator<Key>,
+          typename Allocator = std::allocator<unsigned long>,
+          bloom_filter_policy::SizingPolicy SizingPolicy =
+              bloom_filter_policy::power_of_two>
+class concurrent_bloom_filter {
+ public:
+  using key_type = Key;
+  using hash_type = HashGen::hash_type;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using hash_generator_type = HashGen;
+  using bloom_filter_type = bloom_filter<Key, HashGen, Allocator, SizingPolicy>;
+  using word_type = bloom_filter_type::word_type;
+
+  static constexpr size_type bits_per_word = bloom_filter_type::bits_per_word;
+  static constexpr size_type bits_per_word_log2 =
+      bloom_filter_type::bits_per_word_log2;
+  static constexpr size_type word_mask = bloom_filter_type::word_mask;
+
+  static_assert(std::atomic_ref<word_type>::is_always_lock_free);
+
+  concurrent_bloom_filter(std::size_t num_bits, std::size_t num_hashes,
+                          const Allocator &alloc = Allocator())
+      : num_bits_{SizingPolicy{}(num_bits)},
+        bit_array_((num_bits_ + bits_per_word - 1) / bits_per_word, 0, alloc),
+        hash_generator_(num_hashes, num_bits_) {}
+  concurrent_bloom_filter(std::size_t input_size,
+                          double false_positive_probability = 0.03,
+                          const Allocator &alloc = Allocator())
+      : num_bits_{SizingPolicy{}(bloom_filter_type::optimal_num_bits(
+            input_size, false_positive_probability))},
+        bit_array_((num_bits_ + bits_per_word - 1) / bits_per_word, 0, alloc),
+        hash_generator_(bloom_filter_type::optimal_num_hashes(
+                            input_size, false_positive_probability),
+                        num_bits_) {}
+  concurrent_bloom_filter(HashGen hash_generator,
+                          const Allocator &alloc = Allocator())
+      : num_bits_{hash_generator.range()},
+        bit_array_((num_bits_ + bits_per_word - 1) / bits_per_word, 0, alloc),
+        hash_generator_(std::move(hash_generator)) {}
+
+  // Thread-safe.
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) noexcept {
+    for (auto it = first; it != last; ++it) {
+      insert(*it);
+    }
+  }
+  // Thread-safe. Bits that are already set are only read, which keeps hot
+  // cache lines shared between cores instead of bouncing them on every RMW.
+  void insert(const Key &key) noexcept {
+    for (auto hash : hash_generator_.hashes(key)) {
+      std::atomic_ref<word_type> word(bit_array_[hash >> bits_per_word_log2]);
+      const word_type mask = word_type{1} << (hash & word_mask);
+      if (!(word.load(std::memory_order_relaxed) & mask)) {
+        word.fetch_or(mask, std::memory_order_relaxed);
+      }
+    }
+  }
+  // Thread-safe and wait-free.
+  bool contains(const Key &key) const noexcept {
+    for (auto hash : hash_generator_.hashes(key)) {
+      if (!(load(hash >> bits_per_word_log2) &
+            (word_type{1} << (hash & word_mask))))
+        return false;
+    }
+    return true;
+  }
+  // Not thread-safe.
+  void clear() noexcept { std::fill(bit_array_.begin(), bit_array_.end(), 0); }
+
+  // Returns the number of bits.
+  std::size_t bit_capacity() const noexcept { return num_bits_; }
+
+  // Returns the number of set bits. Concurrent inserts may or may not be
+  // counted.
+  std::size_t num_set_bits() const noexcept {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < bit_array_.size(); ++i) {
+      count += std::popcount(load(i));
+    }
+    return count;
+  }
+
+  HashGen hash_generator() const noexcept { return hash_generator_; }
+
+  std::size_t hashes_per_key() const noexcept {
+    return hash_generator_.hashes_per_key();
+  }
+
+  std::size_t approximate_cardinality() const noexcept {
+    return bloom_filter_type::approximate_cardinality(
+        bit_capacity(), num_set_bits(), hashes_per_key());
+  }
+
+  double approximate_fpp() const noexcept {
+    return bloom_filter_type::false_positive_probability(
+        bit_capacity(), approximate_cardinality(), hashes_per_key());
+  }
+
+  // Returns a single-threaded copy holding every insert that happened before
+  // the call.
+  bloom_filter_type snapshot() const {
+    std::vector<word_type, allocator_type> bits(bit_array_.size(), 0,
+                                                bit_array_.get_allocator());
+    for (std::size_t i = 0; i < bits.size(); ++i) bits[i] = load(i);
+    return bloom_filter_type(hash_generator_, std::move(bits));
+  }
+
+  // Thread-safe with respect to inserts into this filter.
+  concurrent_bloom_filter &operator|=(const bloom_filter_type &other) {
+    assert(other.bit_capacity() == bit_capacity());
+    const auto &words = other.data();
+    for (std::size_t i = 0; i < bit_array_.size(); ++i) {
+      if (words[i]) {
+        std::atomic_ref<word_type>(bit_array_[i])
+            .fetch_or(words[i], std::memory_order_relaxed);
+      }
+    }
+    return *this;
+  }
+
+ private:
+  word_type load(std::size_t index) const noexcept {
+    // atomic_ref needs a non-const referent even for loads.
+    return std::atomic_ref<word_type>(
+               const_cast<word_type &>(bit_array_[index]))
+        .load(std::memory_order_relaxed);
+  }
+
+  std::size_t num_bits_;
+  std::vector<word_type, allocator_type> bit_array_;
+  hash_generator_type hash_generator_;
+};
+
+}  // namespace pds
+#endif
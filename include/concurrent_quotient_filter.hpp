@@ -0,0 +1,349 @@
+#ifndef PDS_CONCURRENT_QUOTIENT_FILTER_HPP
+#define PDS_CONCURRENT_QUOTIENT_FILTER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "hash.hpp"
+#include "quotient_filter.hpp"
+
+// Quotient filter that many threads can insert into, erase from and query
+// at the same time (Pandey et al., "A General-Purpose Counting Filter",
+// section 5). The slots are split into regions of 4096, each with a spin
+// lock. A writer locks the region of its key's home slot and then, in
+// increasing order, every later region up to the last slot its shift
+// reaches, usually none. Writers of keys in different regions run in
+// parallel, and since every writer locks in the same order they cannot
+// deadlock.
+//
+// Lookups take no lock. A lookup reads its home slot's block and its run,
+// and everything that can change those is written under the lock of its
+// home region. That lock doubles as a version counter, odd while held, so a
+// lookup notes it, reads, and retries if a writer held the region in
+// between (a sequence lock). The table words are relaxed atomics (see
+// quotient_detail::load), so a lookup racing a writer's shift reads a mix
+// of old and new words rather than undefined behaviour. Such a mix can
+// still send a scan to the wrong slots, but every scan stops at the end of
+// the table, and the version check then throws its result away.
+//
+// A thread that would rather not wait for a busy region can insert through
+// an inserter, which tries the lock once and otherwise buffers the key.
+
+namespace pds {
+
+template <typename Key, hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>,
+          typename Allocator = std::allocator<unsigned long>>
+class concurrent_quotient_filter {
+ public:
+  using key_type = Key;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using hash_function_type = Hash;
+  using seed_type = typename Hash::seed_type;
+  using quotient_filter_type = quotient_filter<Key, Hash, Allocator>;
+
+  static constexpr size_type blocks_per_region = 64;
+  static constexpr size_type slots_per_region =
+      blocks_per_region * quotient_filter_type::slots_per_block;
+
+  concurrent_quotient_filter(size_type num_bits_quotient,
+                             size_type num_bits_remainder, seed_type seed = 0,
+                             const Allocator &alloc = Allocator())
+      : concurrent_quotient_filter(quotient_filter_type(
+            num_bits_quotient, num_bits_remainder, seed, alloc)) {}
+  concurrent_quotient_filter(size_type input_size,
+                             double false_positive_probability,
+                             seed_type seed = 0,
+                             const Allocator &alloc = Allocator())
+      : concurrent_quotient_filter(quotient_filter_type(
+            input_size, false_positive_probability, seed, alloc)) {}
+  // Takes over a filter, e.g. one built with build_from_sorted() or merge().
+  explicit concurrent_quotient_filter(quotient_filter_type filter)
+      : filter_(std::move(filter)),
+        locks_((filter_.num_blocks_ + blocks_per_region - 1) /
+               blocks_per_region),
+        size_{filter_.size_},
+        num_fingerprints_{filter_.num_fingerprints_},
+        slots_used_{filter_.slots_used_} {}
+
+  // Thread-safe.
+  template <std::input_iterator It>
+  void insert(It first, It last) {
+    for (auto it = first; it != last; ++it) insert(*it);
+  }
+  // Thread-safe. Adds count copies of the key, waiting for the regions it
+  // touches. Throws std::length_error once capacity() slots are in use,
+  // leaving the filter unchanged.
+  void insert(const Key &key, std::uint64_t count = 1) {
+    insert_hash(filter_.hash_of(key), count, true);
+  }
+
+  // Thread-safe and lock-free.
+  bool contains(const Key &key) const noexcept {
+    return count_hash(filter_.hash_of(key)) != 0;
+  }
+  // Thread-safe and lock-free.
+  std::uint64_t count(const Key &key) const noexcept {
+    return count_hash(filter_.hash_of(key));
+  }
+  // Lookups by the key's Hash output under seed().
+  bool contains_hash(std::uint64_t key_hash) const noexcept {
+    return count_hash(key_hash) != 0;
+  }
+  std::uint64_t count_hash(std::uint64_t key_hash) const noexcept {
+    const auto &version =
+        locks_[region(filter_.split(key_hash).first)].version;
+    for (unsigned spins = 0;; backoff(spins)) {
+      const std::uint64_t before = version.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      const std::uint64_t result = filter_.count_hash(key_hash);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (version.load(std::memory_order_relaxed) == before) return result;
+    }
+  }
+
+  // Thread-safe. Removes one copy of the key and returns whether there was
+  // one. Only erase keys that were inserted.
+  bool erase(const Key &key) noexcept {
+    return erase_hash(filter_.hash_of(key), 1) != 0;
+  }
+  // Thread-safe. Removes up to count copies of the key and returns how many
+  // it removed.
+  std::uint64_t erase(const Key &key, std::uint64_t count) noexcept {
+    return erase_hash(filter_.hash_of(key), count);
+  }
+
+  // Per-thread front end for insert() that does not wait for a region
+  // another thread holds: the key is buffered instead, and the buffer is
+  // inserted, waiting, once it holds buffer_size keys, on flush() and on
+  // destruction. Buffered keys are not visible to lookups. An inserter is
+  // used by one thread at a time.
+  class inserter {
+   public:
+    static constexpr size_type buffer_size = 256;
+
+    explicit inserter(concurrent_quotient_filter &filter) : filter_{filter} {
+      pending_.reserve(buffer_size);
+    }
+    inserter(const inserter &) = delete;
+    inserter &operator=(const inserter &) = delete;
+    // Keys that do not fit into the filter are dropped; call flush() first
+    // to see the error.
+    ~inserter() {
+      try {
+        flush();
+      } catch (const std::length_error &) {
+      }
+    }
+
+    // Throws std::length_error as insert() does, or from flushing.
+    void insert(const Key &key, std::uint64_t count = 1) {
+      const std::uint64_t key_hash = filter_.filter_.hash_of(key);
+      if (filter_.insert_hash(key_hash, count, false)) return;
+      pending_.emplace_back(key_hash, count);
+      if (pending_.size() == buffer_size) flush();
+    }
+    // Inserts the buffered keys. If one does not fit, throws
+    // std::length_error and keeps it and those after it.
+    void flush() {
+      size_type done = 0;
+      try {
+        for (; done < pending_.size(); ++done)
+          filter_.insert_hash(pending_[done].first, pending_[done].second,
+                              true);
+      } catch (...) {
+        pending_.erase(pending_.begin(),
+                       pending_.begin() + static_cast<std::ptrdiff_t>(done));
+        throw;
+      }
+      pending_.clear();
+    }
+    size_type pending() const noexcept { return pending_.size(); }
+
+   private:
+    concurrent_quotient_filter &filter_;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> pending_;
+  };
+
+  // Thread-safe: waits for every region, so the copy holds exactly the
+  // inserts and erases that completed before it took them.
+  quotient_filter_type snapshot() const {
+    lock_all();
+    try {
+      quotient_filter_type copy = filter_;
+      copy.size_ = size_.load(std::memory_order_relaxed);
+      copy.num_fingerprints_ = num_fingerprints_.load(std::memory_order_relaxed);
+      copy.slots_used_ = slots_used_.load(std::memory_order_relaxed);
+      unlock(0, locks_.size() - 1);
+      return copy;
+    } catch (...) {
+      unlock(0, locks_.size() - 1);
+      throw;
+    }
+  }
+  // Not thread-safe.
+  void clear() noexcept {
+    filter_.clear();
+    size_ = 0;
+    num_fingerprints_ = 0;
+    slots_used_ = 0;
+  }
+
+  // The counters below are exact once writers have synchronised with the
+  // caller, e.g. been joined, and approximate while they run.
+  size_type size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+  bool empty() const noexcept { return size() == 0; }
+  size_type num_fingerprints() const noexcept {
+    return num_fingerprints_.load(std::memory_order_relaxed);
+  }
+  size_type slots_used() const noexcept {
+    return slots_used_.load(std::memory_order_relaxed);
+  }
+  size_type num_slots() const noexcept { return filter_.num_slots(); }
+  // Inserts start to throw once about this many slots are in use; racing
+  // inserts can overshoot it by a few.
+  size_type capacity() const noexcept { return filter_.capacity(); }
+  double load_factor() const noexcept {
+    return static_cast<double>(slots_used()) /
+           static_cast<double>(num_slots());
+  }
+  double max_load_factor() const noexcept { return filter_.max_load_factor(); }
+  // Not thread-safe.
+  void max_load_factor(double load) { filter_.max_load_factor(load); }
+  double false_positive_probability() const noexcept {
+    return -std::expm1(
+        -static_cast<double>(num_fingerprints()) /
+        static_cast<double>(num_slots()) /
+        std::ldexp(1.0, static_cast<int>(filter_.remainder_bits())));
+  }
+
+  size_type quotient_bits() const noexcept { return filter_.quotient_bits(); }
+  size_type remainder_bits() const noexcept {
+    return filter_.remainder_bits();
+  }
+  size_type size_in_bytes() const noexcept {
+    return filter_.size_in_bytes() + locks_.size() * sizeof(region_lock);
+  }
+  seed_type seed() const noexcept { return filter_.seed(); }
+
+ private:
+  using change = typename quotient_filter_type::change;
+
+  // A lock and sequence counter on its own cache line, so that writers of
+  // neighbouring regions do not slow each other's readers down.
+  struct alignas(64) region_lock {
+    std::atomic<std::uint64_t> version{0};
+  };
+
+  static size_type region(size_type slot) noexcept {
+    return slot / slots_per_region;
+  }
+  // Spins, yielding now and then so that a preempted lock holder can run.
+  static void backoff(unsigned &spins) noexcept {
+    if (++spins % 64 == 0) std::this_thread::yield();
+  }
+
+  bool try_lock(size_type r) const noexcept {
+    auto &version = locks_[r].version;
+    std::uint64_t expected = version.load(std::memory_order_relaxed);
+    if ((expected & 1) ||
+        !version.compare_exchange_strong(expected, expected + 1,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed))
+      return false;
+    // Lookups that see any of the writes below also see the odd version.
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+  }
+  void lock(size_type r) const noexcept {
+    for (unsigned spins = 0; !try_lock(r); backoff(spins)) {
+    }
+  }
+  void lock_all() const noexcept {
+    for (size_type r = 0; r < locks_.size(); ++r) lock(r);
+  }
+  void unlock(size_type first, size_type last) const noexcept {
+    for (size_type r = first; r <= last; ++r)
+      locks_[r].version.fetch_add(1, std::memory_order_release);
+  }
+
+  // Locks the region of quotient, then those up to the one holding the last
+  // slot reach() names, recomputing it as more are taken since other
+  // writers may have filled the empty slots it counted on, runs write() and
+  // unlocks. Returns false without writing if wait is false and the first
+  // region is held.
+  template <typename Reach, typename Write>
+  bool locked_write(size_type quotient, bool wait, Reach &&reach,
+                    Write &&write) {
+    const size_type first = region(quotient);
+    if (wait) {
+      lock(first);
+    } else if (!try_lock(first)) {
+      return false;
+    }
+    size_type last = first;
+    try {
+      for (size_type target;
+           (target = region(std::min(reach(), filter_.total_slots() - 1))) >
+           last;)
+        while (last < target) lock(++last);
+      write();
+    } catch (...) {
+      unlock(first, last);
+      throw;
+    }
+    unlock(first, last);
+    return true;
+  }
+
+  bool insert_hash(std::uint64_t key_hash, std::uint64_t count, bool wait) {
+    if (count == 0) return true;
+    if (slots_used() >= capacity())
+      throw std::length_error("quotient_filter: load factor exceeded");
+    const auto [quotient, remainder] = filter_.split(key_hash);
+    return locked_write(
+        quotient, wait,
+        [&] { return filter_.insert_reach(quotient, remainder, count); },
+        [&] {
+          const change c =
+              filter_.insert_fingerprint(quotient, remainder, count);
+          size_.fetch_add(c.count, std::memory_order_relaxed);
+          num_fingerprints_.fetch_add(c.fingerprint, std::memory_order_relaxed);
+          slots_used_.fetch_add(c.slots, std::memory_order_relaxed);
+        });
+  }
+  std::uint64_t erase_hash(std::uint64_t key_hash,
+                           std::uint64_t count) noexcept {
+    const auto [quotient, remainder] = filter_.split(key_hash);
+    change c;
+    locked_write(
+        quotient, true, [&] { return filter_.erase_reach(quotient); },
+        [&] {
+          c = filter_.erase_fingerprint(quotient, remainder, count);
+          size_.fetch_sub(c.count, std::memory_order_relaxed);
+          num_fingerprints_.fetch_sub(c.fingerprint, std::memory_order_relaxed);
+          slots_used_.fetch_sub(c.slots, std::memory_order_relaxed);
+        });
+    return c.count;
+  }
+
+  // Its own counters are unused; the atomics below replace them.
+  quotient_filter_type filter_;
+  mutable std::vector<region_lock> locks_;
+  std::atomic<size_type> size_;
+  std::atomic<size_type> num_fingerprints_;
+  std::atomic<size_type> slots_used_;
+};
+
+}  // namespace pds
+#endif
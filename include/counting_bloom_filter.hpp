@@ -0,0 +1,208 @@
+#ifndef PDS_COUNTING_BLOOM_FILTER_HPP
+#define PDS_COUNTING_BLOOM_FILTER_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "bloom_filter.hpp"
+#include "hash.hpp"
+
+// Counting Bloom filter (Fan et al., "Summary Cache") with 4-bit saturating
+// counters packed sixteen to a word. A counter that reaches 15 sticks there,
+// since its true value is no longer known, so erase never creates false
+// negatives. Counter i corresponds to bit i of a bloom_filter with the same
+// hash generator, which makes to_bloom_filter a word-parallel pass.
+
+namespace pds {
+
+template <typename Key,
+          hash::HashGenerator<Key> HashGen =
+              pds::hash::default_hash_generator<Key>,
+          typename Allocator = std::allocator<unsigned long>,
+          bloom_filter_policy::SizingPolicy SizingPolicy =
+              bloom_filter_policy::power_of_two>
+class counting_bloom_filter {
+ public:
+  using key_type = Key;
+  using hash_type = HashGen::hash_type;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using hash_generator_type = HashGen;
+  using bloom_filter_type = bloom_filter<Key, HashGen, Allocator, SizingPolicy>;
+  using word_type = bloom_filter_type::word_type;
+
+  static constexpr size_type counter_bits = 4;
+  static constexpr size_type counter_max = (1u << counter_bits) - 1u;
+  static constexpr size_type counters_per_word =
+      std::numeric_limits<word_type>::digits / counter_bits;
+  static constexpr size_type counters_per_word_log2 =
+      std::countr_zero(counters_per_word);
+
+  counting_bloom_filter(std::size_t num_counters, std::size_t num_hashes,
+                        const Allocator &alloc = Allocator())
+      : num_counters_{SizingPolicy{}(num_counters)},
+        counters_(words_for(num_counters_), 0, alloc),
+        hash_generator_(num_hashes, num_counters_) {}
+  counting_bloom_filter(std::size_t input_size,
+                        double false_positive_probability = 0.03,
+                        const Allocator &alloc = Allocator())
+      : num_counters_{SizingPolicy{}(bloom_filter_type::optimal_num_bits(
+            input_size, false_positive_probability))},
+        counters_(words_for(num_counters_), 0, alloc),
+        hash_generator_(bloom_filter_type::optimal_num_hashes(
+                            input_size, false_positive_probability),
+                        num_counters_) {}
+  counting_bloom_filter(HashGen hash_generator,
+                        const Allocator &alloc = Allocator())
+      : num_counters_{hash_generator.range()},
+        counters_(words_for(num_counters_), 0, alloc),
+        hash_generator_(std::move(hash_generator)) {}
+
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) noexcept {
+    for (auto it = first; it != last; ++it) {
+      insert(*it);
+    }
+  }
+  void insert(const Key &key) noexcept {
+    for (auto hash : hash_generator_.hashes(key)) {
+      auto &word = counters_[hash >> counters_per_word_log2];
+      const auto shift = counter_shift(hash);
+      word += word_type{counter(word, shift) != counter_max} << shift;
+    }
+  }
+  // Removes one occurrence of key. Keys that are not (probably) present are
+  // left alone and false is returned, so erasing a never-inserted key cannot
+  // underflow counters shared with other keys.
+  bool erase(const Key &key) noexcept {
+    if (!contains(key)) return false;
+    for (auto hash : hash_generator_.hashes(key)) {
+      auto &word = counters_[hash >> counters_per_word_log2];
+      const auto shift = counter_shift(hash);
+      word -= word_type{counter(word, shift) != counter_max} << shift;
+    }
+    return true;
+  }
+  bool contains(const Key &key) const noexcept {
+    for (auto hash : hash_generator_.hashes(key)) {
+      if (!counter(counters_[hash >> counters_per_word_log2],
+                   counter_shift(hash)))
+        return false;
+    }
+    return true;
+  }
+  // Upper bound on the number of times key was inserted (minimum of its
+  // counters), saturating at counter_max.
+  std::size_t count_estimate(const Key &key) const noexcept {
+    std::size_t count = counter_max;
+    for (auto hash : hash_generator_.hashes(key)) {
+      count = std::min<std::size_t>(
+          count, counter(counters_[hash >> counters_per_word_log2],
+                         counter_shift(hash)));
+    }
+    return count;
+  }
+  void clear() noexcept { std::fill(counters_.begin(), counters_.end(), 0); }
+
+  // Returns the number of counters.
+  std::size_t counter_capacity() const noexcept { return num_counters_; }
+
+  // Returns the number of non-zero counters.
+  std::size_t num_set_counters() const noexcept {
+    std::size_t count = 0;
+    for (auto word : counters_) count += std::popcount(nonzero_nibbles(word));
+    return count;
+  }
+
+  HashGen hash_generator() const noexcept { return hash_generator_; }
+
+  std::size_t hashes_per_key() const noexcept {
+    return hash_generator_.hashes_per_key();
+  }
+
+  bool empty() const noexcept {
+    return std::all_of(counters_.begin(), counters_.end(),
+                       [](word_type x) { return x == 0; });
+  }
+
+  void swap(counting_bloom_filter &other) noexcept {
+    std::swap(num_counters_, other.num_counters_);
+    counters_.swap(other.counters_);
+    std::swap(hash_generator_, other.hash_generator_);
+  }
+
+  const std::vector<word_type, allocator_type> &data() const noexcept {
+    return counters_;
+  }
+
+  // Adds the counters of other, saturating each at counter_max.
+  counting_bloom_filter &operator+=(const counting_bloom_filter &other) {
+    assert(other.counter_capacity() == counter_capacity());
+    for (std::size_t i = 0; i < counters_.size(); ++i) {
+      counters_[i] = saturating_add(counters_[i], other.counters_[i]);
+    }
+    return *this;
+  }
+
+  // Returns a plain Bloom filter with bit i set iff counter i is non-zero. It
+  // answers contains exactly like this filter at a quarter of the memory.
+  bloom_filter_type to_bloom_filter() const {
+    constexpr size_type ratio = std::numeric_limits<word_type>::digits /
+                                counters_per_word;
+    std::vector<word_type, allocator_type> bits(
+        (counters_.size() + ratio - 1) / ratio, 0, counters_.get_allocator());
+    for (std::size_t i = 0; i < counters_.size(); ++i) {
+      bits[i / ratio] |= compress(nonzero_nibbles(counters_[i]))
+                         << ((i % ratio) * counters_per_word);
+    }
+    return bloom_filter_type(hash_generator_, std::move(bits));
+  }
+
+ private:
+  static constexpr word_type nibble_low_bits = ~word_type{0} / 0xF;
+  static constexpr word_type nibble_high_bits = nibble_low_bits << 3;
+
+  static size_type words_for(size_type num_counters) {
+    return (num_counters + counters_per_word - 1) / counters_per_word;
+  }
+  static size_type counter_shift(size_type index) noexcept {
+    return (index & (counters_per_word - 1)) * counter_bits;
+  }
+  static size_type counter(word_type word, size_type shift) noexcept {
+    return (word >> shift) & counter_max;
+  }
+
+  // Sets the lowest bit of every non-zero nibble.
+  static word_type nonzero_nibbles(word_type word) noexcept {
+    word |= word >> 1;
+    word |= word >> 2;
+    return word & nibble_low_bits;
+  }
+  // Gathers bit 4i of a nonzero_nibbles() mask into bit i.
+  static word_type compress(word_type x) noexcept {
+    x = (x | (x >> 3)) & 0x0303030303030303ul;
+    x = (x | (x >> 6)) & 0x000F000F000F000Ful;
+    x = (x | (x >> 12)) & 0x000000FF000000FFul;
+    x = (x | (x >> 24)) & 0x000000000000FFFFul;
+    return x;
+  }
+  // Adds sixteen nibbles in parallel, clamping each at counter_max.
+  static word_type saturating_add(word_type a, word_type b) noexcept {
+    const word_type low = (a & ~nibble_high_bits) + (b & ~nibble_high_bits);
+    const word_type sum = low ^ ((a ^ b) & nibble_high_bits);
+    const word_type carry = ((a & b) | (low & (a ^ b))) & nibble_high_bits;
+    return sum | ((carry >> 3) * counter_max);
+  }
+
+  std::size_t num_counters_;
+  std::vector<word_type, allocator_type> counters_;
+  hash_generator_type hash_generator_;
+};
+
+}  // namespace pds
+#endif
@@ -1,20 +1,65 @@
 #ifndef PDS_HASH_HPP
 #define PDS_HASH_HPP
 
+#include <bit>
 #include <limits>
 #include <queue>
 #include <random>
 #include <ranges>
+#include <span>
 #include <concepts>
 #include <cstdint>
 #include <unordered_set>
 #include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
 
 #include "MurmurHash3.h"
 
 namespace pds {
 namespace hash {
 
+// Keys hashed by their contents: contiguous ranges of trivially copyable
+// elements, e.g. std::string, std::string_view, std::vector<int> or
+// std::span<const std::byte>.
+template <typename T>
+concept ContiguousKey =
+    std::ranges::contiguous_range<const T> &&
+    std::ranges::sized_range<const T> &&
+    std::is_trivially_copyable_v<std::ranges::range_value_t<const T>>;
+
+// The bytes a hash function sees for a key: the contents of a ContiguousKey,
+// read in place, and the object representation of anything else. Specialize
+// for key types that need something different, e.g. ones with padding.
+template <typename Key>
+struct key_traits {
+  static std::span<const std::byte> bytes(const Key &key) noexcept {
+    if constexpr (ContiguousKey<Key>) {
+      return std::as_bytes(
+          std::span{std::ranges::data(key), std::ranges::size(key)});
+    } else {
+      return {reinterpret_cast<const std::byte *>(&key), sizeof(Key)};
+    }
+  }
+};
+
+// K can be looked up in a filter of Key without converting it: both are
+// contiguous ranges of the same element type, so equal contents hash alike,
+// e.g. std::string_view for std::string. Arrays are left out, since a string
+// literal would include its terminator. The filters' contains (and count)
+// overloads constrained on this concept take such keys directly.
+template <typename K, typename Key>
+concept TransparentKey =
+    !std::same_as<K, Key> && !std::is_array_v<K> && ContiguousKey<K> &&
+    ContiguousKey<Key> &&
+    std::same_as<std::remove_cv_t<std::ranges::range_value_t<const K>>,
+                 std::remove_cv_t<std::ranges::range_value_t<const Key>>>;
+
+// Key itself or a TransparentKey for it.
+template <typename K, typename Key>
+concept KeyLike = std::same_as<K, Key> || TransparentKey<K, Key>;
+
 template <typename T, typename Key>
 concept HashFunction = requires(T t) {
   typename T::hash_type;
@@ -43,10 +88,43 @@ concept HashGenerator = requires(T t, size_t n, Key k) {
                         typename T::hash_type>;
 };
 
+// Range functions map a hash to [0, range). Stateless ones take the range on
+// every call; stateful ones are constructed once per range, so they can
+// precompute constants such as a division magic number.
 template <typename T, typename HashType>
-concept RangeFunction = std::unsigned_integral<HashType> && requires(T t, HashType h, std::size_t n) {
+concept StatelessRangeFunction = std::unsigned_integral<HashType> && requires(T t, HashType h, std::size_t n) {
   { T{}(h, n) } -> std::same_as<HashType>;
 };
+template <typename T, typename HashType>
+concept StatefulRangeFunction =
+    std::unsigned_integral<HashType> && std::constructible_from<T, HashType> &&
+    requires(const T t, HashType h) {
+      { t(h) } -> std::same_as<HashType>;
+    };
+template <typename T, typename HashType>
+concept RangeFunction = StatelessRangeFunction<T, HashType> ||
+                        StatefulRangeFunction<T, HashType>;
+
+// A range function bound to one range, as stored by the hash generators.
+template <typename Range, typename HashType,
+          bool Stateful = StatefulRangeFunction<Range, HashType>>
+class range_reducer {
+ public:
+  explicit range_reducer(HashType range) : range_{range} {}
+  HashType operator()(HashType hash) const { return Range{}(hash, range_); }
+
+ private:
+  HashType range_;
+};
+template <typename Range, typename HashType>
+class range_reducer<Range, HashType, true> {
+ public:
+  explicit range_reducer(HashType range) : range_{range} {}
+  HashType operator()(HashType hash) const { return range_(hash); }
+
+ private:
+  Range range_;
+};
 
 template <std::unsigned_integral T = std::size_t>
 struct mod_range {
@@ -81,23 +159,124 @@ struct fast_range<uint64_t> {
 };
 #endif
 
+// hash % range without a division per call. Uses Lemire, Kaser and Kurz,
+// "Faster Remainder by Direct Computation" for 32-bit hashes and a
+// libdivide-style branchfree quotient for 64-bit ones; the constants are
+// computed once for the range. Produces exactly the values of mod_range, so
+// it keeps the uniformity of prime-sized filters.
+template <std::unsigned_integral T>
+class fast_mod_range {
+ public:
+  explicit fast_mod_range(T range) : range_{range} {}
+  T operator()(T hash) const { return hash % range_; }
+
+ private:
+  T range_;
+};
+#ifdef __SIZEOF_INT128__
+template <>
+class fast_mod_range<uint32_t> {
+ public:
+  explicit fast_mod_range(uint32_t range)
+      : magic_{std::numeric_limits<uint64_t>::max() / range + 1},
+        range_{range} {
+    assert(range != 0);
+  }
+  uint32_t operator()(uint32_t hash) const {
+    const uint64_t low = magic_ * hash;
+    return static_cast<uint32_t>(
+        (static_cast<__uint128_t>(low) * range_) >> 64);
+  }
+
+ private:
+  uint64_t magic_;
+  uint64_t range_;
+};
+template <>
+class fast_mod_range<uint64_t> {
+ public:
+  explicit fast_mod_range(uint64_t range) : range_{range} {
+    assert(range != 0);
+    const int log2 = std::bit_width(range) - 1;
+    if (range == 1) {
+      // hash % 1 is 0; the quotient below would need a shift by -1.
+      mask_ = 0;
+      return;
+    }
+    if (std::has_single_bit(range)) {
+      // magic_ == 0 turns the quotient below into hash >> log2.
+      shift_ = log2 - 1;
+      return;
+    }
+    const __uint128_t numerator = static_cast<__uint128_t>(1) << (64 + log2);
+    uint64_t m = static_cast<uint64_t>(numerator / range);
+    const uint64_t rem = static_cast<uint64_t>(numerator % range);
+    m += m;
+    const uint64_t twice_rem = rem + rem;
+    if (twice_rem >= range || twice_rem < rem) m += 1;
+    magic_ = m + 1;
+    shift_ = log2;
+  }
+  uint64_t operator()(uint64_t hash) const {
+    const auto q = static_cast<uint64_t>(
+        (static_cast<__uint128_t>(magic_) * hash) >> 64);
+    const uint64_t quotient = (((hash - q) >> 1) + q) >> shift_;
+    return (hash - quotient * range_) & mask_;
+  }
+
+ private:
+  uint64_t magic_ = 0;
+  uint64_t range_;
+  uint64_t mask_ = ~uint64_t{0};
+  int shift_ = 0;
+};
+#endif
+
+// Which bits of the hash a range function keeps for a power of two range:
+// the low ones (hash % range) or the high ones (multiply-shift). Filters of
+// different power of two sizes can derive their positions from one hash only
+// if this is known.
+enum class range_bits { unknown, low, high };
+template <typename Range>
+inline constexpr range_bits range_bits_v = range_bits::unknown;
+template <typename T>
+inline constexpr range_bits range_bits_v<mod_range<T>> = range_bits::low;
+template <typename T>
+inline constexpr range_bits range_bits_v<fast_mod_range<T>> = range_bits::low;
+template <typename T>
+inline constexpr range_bits range_bits_v<pow_2_range<T>> = range_bits::high;
+template <typename T>
+inline constexpr range_bits range_bits_v<fast_range<T>> = range_bits::low;
+template <>
+inline constexpr range_bits range_bits_v<fast_range<uint32_t>> =
+    range_bits::high;
+#ifdef __SIZEOF_INT128__
+template <>
+inline constexpr range_bits range_bits_v<fast_range<uint64_t>> =
+    range_bits::high;
+#endif
+
 template <typename Key, HashFunction<Key> Hash, RangeFunction<typename Hash::hash_type> Range = mod_range<typename Hash::hash_type>>
 class simple_hash_generator {
   using seed_type = typename Hash::seed_type;
  public:
   using hash_type = typename Hash::hash_type;
   using key_type = Key;
+  using range_type = Range;
   simple_hash_generator(size_t hashes_per_key, size_t range = std::numeric_limits<hash_type>::max())
-      : _hashes_per_key(hashes_per_key), range_{range} {
+      : _hashes_per_key(hashes_per_key), range_{range},
+        reduce_{static_cast<hash_type>(range)} {
         if constexpr (std::same_as<Range, pow_2_range<typename Hash::hash_type>>) {
           // Check if range is a power of 2
           assert((range & (range - 1)) == 0);
         }
       }
-  auto hashes(const key_type &key) const {
+  template <KeyLike<Key> K = Key>
+    requires std::invocable<Hash, const K &, seed_type>
+  auto hashes(const K &key) const {
     return std::views::iota(0u, _hashes_per_key) |
            std::views::transform(
-               [&](seed_type seed) { return Range{}(Hash{}(key, seed), range_); });
+               [&](seed_type seed) { return reduce_(Hash{}(key, seed)); });
   }
 
   size_t hashes_per_key() const { return _hashes_per_key; }
@@ -105,23 +284,119 @@ class simple_hash_generator {
 
  private:
   size_t _hashes_per_key, range_;
+  range_reducer<Range, hash_type> reduce_;
+};
+
+// Probe sequences for double_hash_generator. Both derive the i-th position
+// from the two halves of one 128-bit hash (Kirsch and Mitzenmacher, "Less
+// Hashing, Same Performance").
+struct double_hashing {
+  uint64_t operator()(uint64_t h1, uint64_t h2, uint64_t i) const {
+    return h1 + i * h2;
+  }
+};
+// Adds a cubic term so that two keys colliding on (h1, h2) mod range do not
+// collide on every probe (Dillinger and Manolios, "Bloom Filters in
+// Probabilistic Verification").
+struct enhanced_double_hashing {
+  uint64_t operator()(uint64_t h1, uint64_t h2, uint64_t i) const {
+    return h1 + i * h2 + (i * i * i - i) / 6;
+  }
+};
+
+// The 128-bit hash double_hash_generator derives every position from. It does
+// not depend on the range, so one prehashed key can be probed against many
+// filters of different sizes, hashing the key only once; the filters must
+// share a seed.
+struct prehashed_key {
+  uint64_t h1, h2;
+};
+
+template <typename Key>
+prehashed_key prehash(const Key &key, uint32_t seed = 0) noexcept {
+  const auto bytes = key_traits<Key>::bytes(key);
+  uint64_t hash[2];
+  MurmurHash3_x64_128(bytes.data(), static_cast<int>(bytes.size()), seed, hash);
+  // An odd stride visits every slot of a power of two sized range.
+  return {hash[0], hash[1] | 1u};
+}
+
+// Generators whose positions can be computed from a prehashed_key.
+template <typename T>
+concept PrehashGenerator = requires(const T &g, const prehashed_key &key) {
+  { g.hashes(key) } -> std::ranges::range;
 };
 
+// Makes a single MurmurHash3_x64_128 call per key and derives all positions
+// from it, so the hashing cost no longer grows with the number of hashes.
+template <typename Key, RangeFunction<uint64_t> Range = mod_range<uint64_t>,
+          typename Probe = double_hashing>
+class double_hash_generator {
+ public:
+  using hash_type = uint64_t;
+  using key_type = Key;
+  using seed_type = uint32_t;
+  using range_type = Range;
+  double_hash_generator(size_t hashes_per_key,
+                        size_t range = std::numeric_limits<hash_type>::max(),
+                        seed_type seed = 0)
+      : _hashes_per_key(hashes_per_key), range_{range}, seed_{seed},
+        reduce_{range} {
+    if constexpr (std::same_as<Range, pow_2_range<hash_type>>) {
+      // Check if range is a power of 2
+      assert((range & (range - 1)) == 0);
+    }
+  }
+  template <KeyLike<Key> K = Key>
+  auto hashes(const K &key) const {
+    return hashes(prehash(key));
+  }
+  auto hashes(const prehashed_key &key) const {
+    return std::views::iota(uint64_t{0}, uint64_t{_hashes_per_key}) |
+           std::views::transform(
+               [h1 = key.h1, h2 = key.h2, reduce = reduce_](uint64_t i) {
+                 return reduce(Probe{}(h1, h2, i));
+               });
+  }
+  template <KeyLike<Key> K = Key>
+  prehashed_key prehash(const K &key) const noexcept {
+    return hash::prehash(key, seed_);
+  }
+
+  size_t hashes_per_key() const { return _hashes_per_key; }
+  size_t range() const { return range_; }
+  seed_type seed() const { return seed_; }
+
+ private:
+  size_t _hashes_per_key, range_;
+  seed_type seed_;
+  range_reducer<Range, hash_type> reduce_;
+};
+
+template <typename Key, RangeFunction<uint64_t> Range = mod_range<uint64_t>>
+using enhanced_double_hash_generator =
+    double_hash_generator<Key, Range, enhanced_double_hashing>;
+
 template <typename Key, HashFunction<Key> Hash,
           typename Allocator = std::allocator<typename Hash::seed_type>, RangeFunction<typename Hash::hash_type> Range = mod_range<typename Hash::hash_type>>
 class seeded_hash_generator {
  public:
   using seed_type = typename Hash::seed_type;
   using hash_type = typename Hash::hash_type;
+  using key_type = Key;
+  using range_type = Range;
   seeded_hash_generator(size_t num_hashes,
+                        size_t range = std::numeric_limits<hash_type>::max(),
                         unsigned int rng_seed = std::random_device{}(),
                         const Allocator &alloc = Allocator())
-      : _seeds(num_hashes, alloc) {
+      : _seeds(num_hashes, alloc), range_{range},
+        reduce_{static_cast<hash_type>(range)} {
     auto engine = std::mt19937_64{rng_seed};
     auto dist = std::uniform_int_distribution<seed_type>{
         std::numeric_limits<seed_type>::min(),
         std::numeric_limits<seed_type>::max()};
-    std::unordered_set<seed_type, std::hash<Key>, std::equal_to<Key>, Allocator>
+    std::unordered_set<seed_type, std::hash<seed_type>,
+                       std::equal_to<seed_type>, Allocator>
         previous_seeds(alloc);
     for (auto &seed : _seeds) {
       seed = dist(engine);
@@ -129,29 +404,49 @@ class seeded_hash_generator {
       previous_seeds.insert(seed);
     }
   }
-  seeded_hash_generator(std::initializer_list<seed_type> seeds,
+  // Takes a span rather than an initializer_list so that T{n} still picks
+  // the constructor above, as HashGenerator requires.
+  seeded_hash_generator(std::span<const seed_type> seeds,
+                        size_t range = std::numeric_limits<hash_type>::max(),
                         const Allocator &alloc = Allocator())
-      : _seeds(seeds, alloc) {}
-  auto hashes(const Key &key) const {
+      : _seeds(seeds.begin(), seeds.end(), alloc), range_{range},
+        reduce_{static_cast<hash_type>(range)} {}
+  template <KeyLike<Key> K = Key>
+    requires std::invocable<Hash, const K &, seed_type>
+  auto hashes(const K &key) const {
     return _seeds | std::views::transform(
-                        [&](seed_type seed) { return Range{}(Hash{}(key, seed)); });
+                        [&](seed_type seed) { return reduce_(Hash{}(key, seed)); });
   }
 
   std::vector<seed_type, Allocator> get_seeds() const { return _seeds; }
   size_t hashes_per_key() const { return _seeds.size(); }
+  size_t range() const { return range_; }
 
  private:
   std::vector<seed_type, Allocator> _seeds;
+  size_t range_;
+  range_reducer<Range, hash_type> reduce_;
 };
 
+// The range_bits of a generator's range function, if it names one.
+template <typename Generator>
+inline constexpr range_bits generator_range_bits_v = range_bits::unknown;
+template <typename Generator>
+  requires requires { typename Generator::range_type; }
+inline constexpr range_bits generator_range_bits_v<Generator> =
+    range_bits_v<typename Generator::range_type>;
+
 template <typename Key>
 struct murmer3_x64_128 {
   using seed_type = uint32_t;
   using hash_type = uint64_t;
   using key_type = Key;
-  hash_type operator()(const key_type &key, seed_type seed) {
+  template <KeyLike<Key> K = Key>
+  hash_type operator()(const K &key, seed_type seed) const {
+    const auto bytes = key_traits<K>::bytes(key);
     uint64_t hash[2];
-    MurmurHash3_x64_128(&key, sizeof(Key), seed, hash);
+    MurmurHash3_x64_128(bytes.data(), static_cast<int>(bytes.size()), seed,
+                        hash);
     return hash[0];
   }
 };
@@ -161,9 +456,12 @@ struct murmer3_x86_32 {
   using seed_type = uint32_t;
   using hash_type = uint32_t;
   using key_type = Key;
-  hash_type operator()(const key_type &key, seed_type seed) {
+  template <KeyLike<Key> K = Key>
+  hash_type operator()(const K &key, seed_type seed) const {
+    const auto bytes = key_traits<K>::bytes(key);
     uint32_t hash;
-    MurmurHash3_x86_32(&key, sizeof(Key), seed, &hash);
+    MurmurHash3_x86_32(bytes.data(), static_cast<int>(bytes.size()), seed,
+                       &hash);
     return hash;
   }
 };
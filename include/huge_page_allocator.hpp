@@ -0,0 +1,162 @@
+#ifndef PDS_HUGE_PAGE_ALLOCATOR_HPP
+#define PDS_HUGE_PAGE_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+#include <sys/mman.h>
+
+// Allocators for filter storage. Random probes into a multi-GB bit array miss
+// the TLB on nearly every lookup with 4 KiB pages; backing it with 2 MiB pages
+// cuts the page walks by a factor of 512. Both allocators are stateless and
+// return memory aligned to at least a cache line, and both plug into the
+// Allocator parameter of the filters, e.g.
+//
+//   pds::bloom_filter<int, pds::hash::default_hash_generator<int>,
+//                     pds::huge_page_allocator<unsigned long>> bf(...);
+
+namespace pds {
+
+inline constexpr std::size_t cache_line_size = 64;
+
+// std::allocator with a minimum alignment, e.g. to keep words that are
+// probed together in one cache line.
+template <typename T, std::size_t Alignment = cache_line_size>
+class aligned_allocator {
+  static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0);
+
+ public:
+  using value_type = T;
+  static constexpr std::size_t alignment = Alignment;
+
+  template <typename U>
+  struct rebind {
+    using other = aligned_allocator<U, Alignment>;
+  };
+
+  aligned_allocator() noexcept = default;
+  template <typename U>
+  aligned_allocator(const aligned_allocator<U, Alignment> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+      throw std::bad_array_new_length();
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+  }
+  void deallocate(T *p, std::size_t n) noexcept {
+    ::operator delete(p, n * sizeof(T), std::align_val_t{Alignment});
+  }
+
+  template <typename U>
+  bool operator==(const aligned_allocator<U, Alignment> &) const noexcept {
+    return true;
+  }
+};
+
+enum class huge_page_policy {
+  // Anonymous mapping aligned to a huge page with madvise(MADV_HUGEPAGE), so
+  // transparent huge pages back it whenever the kernel has them available.
+  transparent,
+  // Try MAP_HUGETLB from the reserved huge page pool first (no fragmentation
+  // risk, no khugepaged delay) and fall back to transparent if the pool is
+  // empty or absent.
+  explicit_then_transparent,
+};
+
+namespace huge_page_detail {
+
+inline constexpr std::size_t huge_page_size = std::size_t{2} << 20;
+
+inline std::size_t round_up(std::size_t bytes) noexcept {
+  return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+inline void *map_explicit(std::size_t bytes) noexcept {
+#ifdef MAP_HUGETLB
+  void *p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED) return p;
+#endif
+  (void)bytes;
+  return nullptr;
+}
+
+// Maps bytes (a multiple of the huge page size) at a huge page aligned
+// address by over-mapping one page and unmapping the slack on both sides.
+inline void *map_transparent(std::size_t bytes) {
+  const std::size_t padded = bytes + huge_page_size;
+  void *raw = ::mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) throw std::bad_alloc();
+  const auto begin = reinterpret_cast<std::uintptr_t>(raw);
+  const auto aligned = (begin + huge_page_size - 1) & ~(huge_page_size - 1);
+  if (aligned != begin) ::munmap(raw, aligned - begin);
+  const std::size_t tail = begin + padded - (aligned + bytes);
+  if (tail) ::munmap(reinterpret_cast<void *>(aligned + bytes), tail);
+  void *p = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+  // Advisory: without THP support the mapping simply keeps 4 KiB pages.
+  ::madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+  return p;
+}
+
+}  // namespace huge_page_detail
+
+// Allocations of at least one huge page are served by mmap as described by
+// Policy and rounded up to whole huge pages; smaller ones, where a huge page
+// would mostly be waste, come from cache line aligned operator new.
+template <typename T,
+          huge_page_policy Policy = huge_page_policy::transparent>
+class huge_page_allocator {
+ public:
+  using value_type = T;
+  static constexpr std::size_t huge_page_size =
+      huge_page_detail::huge_page_size;
+  static constexpr huge_page_policy policy = Policy;
+
+  template <typename U>
+  struct rebind {
+    using other = huge_page_allocator<U, Policy>;
+  };
+
+  huge_page_allocator() noexcept = default;
+  template <typename U>
+  huge_page_allocator(const huge_page_allocator<U, Policy> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T) -
+                huge_page_size)
+      throw std::bad_array_new_length();
+    const std::size_t bytes = n * sizeof(T);
+    if (bytes < huge_page_size) {
+      return static_cast<T *>(
+          ::operator new(bytes, std::align_val_t{cache_line_size}));
+    }
+    const std::size_t mapped = huge_page_detail::round_up(bytes);
+    if constexpr (Policy == huge_page_policy::explicit_then_transparent) {
+      if (void *p = huge_page_detail::map_explicit(mapped))
+        return static_cast<T *>(p);
+    }
+    return static_cast<T *>(huge_page_detail::map_transparent(mapped));
+  }
+  void deallocate(T *p, std::size_t n) noexcept {
+    const std::size_t bytes = n * sizeof(T);
+    if (bytes < huge_page_size) {
+      ::operator delete(p, bytes, std::align_val_t{cache_line_size});
+      return;
+    }
+    ::munmap(p, huge_page_detail::round_up(bytes));
+  }
+
+  template <typename U>
+  bool operator==(const huge_page_allocator<U, Policy> &) const noexcept {
+    return true;
+  }
+};
+
+}  // namespace pds
+#endif
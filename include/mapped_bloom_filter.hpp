@@ -0,0 +1,208 @@
+#ifndef PDS_MAPPED_BLOOM_FILTER_HPP
+#define PDS_MAPPED_BLOOM_FILTER_HPP
+
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include "bit_kernels.hpp"
+#include "bloom_filter.hpp"
+#include "crc32c.hpp"
+#include "hash.hpp"
+#include "mapped_file.hpp"
+#include "serialization.hpp"
+
+// Bloom filter whose bit array lives in a memory-mapped file. Lookups run on
+// the mapped words directly, so opening a filter costs a mmap call instead of
+// a read and copy proportional to its size. Files are either in the format of
+// serialization.hpp (open, create) or raw bit arrays in the layout of
+// bloom_filter::data() whose parameters are known out of band.
+
+namespace pds {
+
+template <typename Key,
+          hash::HashGenerator<Key> HashGen =
+              pds::hash::default_hash_generator<Key>>
+class mapped_bloom_filter {
+ public:
+  using key_type = Key;
+  using hash_type = HashGen::hash_type;
+  using size_type = std::size_t;
+  using hash_generator_type = HashGen;
+  using word_type = unsigned long;
+
+  static constexpr size_type bits_per_word =
+      std::numeric_limits<word_type>::digits;
+  static constexpr size_type bits_per_word_log2 =
+      std::countr_zero(bits_per_word);
+  static constexpr size_type word_mask = bits_per_word - 1u;
+
+  // Maps a raw bit array. The generator's range is the number of bits.
+  mapped_bloom_filter(const std::string &path, HashGen hash_generator,
+                      const map_options &options = {},
+                      std::size_t payload_offset = 0)
+      : file_(path, options), hash_generator_(std::move(hash_generator)) {
+    bind(payload_offset);
+  }
+  // Maps a file written by serialization::save (or create). Only the header
+  // is read; the checksum is checked by verify() on request so that opening
+  // does not page in the whole filter.
+  static mapped_bloom_filter open(const std::string &path,
+                                  const map_options &options = {})
+    requires serialization::SerializableGenerator<HashGen>
+  {
+    mapped_file file(path, options);
+    serialization::header h;
+    if (file.size() < sizeof(h))
+      throw serialization::format_error("truncated bloom filter header");
+    std::memcpy(&h, file.data(), sizeof(h));
+    serialization::validate<HashGen, word_type>(h);
+    if (file.size() < h.payload_offset + h.payload_bytes + sizeof(crc_type))
+      throw serialization::format_error("truncated bloom filter payload");
+    mapped_bloom_filter bf(std::move(file),
+                           serialization::generator_traits<HashGen>::make(
+                               h.num_hashes, h.num_bits, h.seed),
+                           h.payload_offset);
+    bf.checksum_offset_ = h.payload_offset + h.payload_bytes;
+    return bf;
+  }
+  // Creates a file in the serialization format holding an empty filter and
+  // maps it read-write, so inserts go straight to the file. Call
+  // update_checksum before handing the file to readers that verify it.
+  static mapped_bloom_filter create(const std::string &path,
+                                    HashGen hash_generator,
+                                    const map_options &options = {})
+    requires serialization::SerializableGenerator<HashGen>
+  {
+    const auto h =
+        serialization::make_header<HashGen, word_type>(hash_generator);
+    mapped_bloom_filter bf(
+        mapped_file::create(
+            path, h.payload_offset + h.payload_bytes + sizeof(crc_type),
+            options),
+        std::move(hash_generator), h.payload_offset);
+    std::memcpy(bf.file_.data(), &h, sizeof(h));
+    bf.checksum_offset_ = h.payload_offset + h.payload_bytes;
+    bf.update_checksum();
+    return bf;
+  }
+
+  // Throws std::logic_error on a read-only mapping.
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) {
+    require_writable();
+    for (auto it = first; it != last; ++it) {
+      set_bits(*it);
+    }
+  }
+  void insert(const Key &key) {
+    require_writable();
+    set_bits(key);
+  }
+  bool contains(const Key &key) const noexcept {
+    for (auto hash : hash_generator_.hashes(key)) {
+      if (!(words_[hash >> bits_per_word_log2] &
+            (word_type{1} << (hash & word_mask))))
+        return false;
+    }
+    return true;
+  }
+
+  // Returns the number of bits.
+  std::size_t bit_capacity() const noexcept {
+    return hash_generator_.range();
+  }
+
+  // Returns the number of set bits. Touches every page of the mapping.
+  std::size_t num_set_bits() const noexcept {
+    return simd::popcount(words_.data(), words_.size());
+  }
+
+  HashGen hash_generator() const noexcept { return hash_generator_; }
+
+  std::size_t hashes_per_key() const noexcept {
+    return hash_generator_.hashes_per_key();
+  }
+
+  std::size_t approximate_cardinality() const noexcept {
+    return bloom_filter<Key, HashGen>::approximate_cardinality(
+        bit_capacity(), num_set_bits(), hashes_per_key());
+  }
+
+  double approximate_fpp() const noexcept {
+    return bloom_filter<Key, HashGen>::false_positive_probability(
+        bit_capacity(), approximate_cardinality(), hashes_per_key());
+  }
+
+  std::span<const word_type> data() const noexcept { return words_; }
+
+  bool writable() const noexcept { return file_.writable(); }
+  // Hints the kernel about the coming access pattern, e.g. will_need to
+  // start paging in a lazily mapped filter in the background.
+  void advise(access_advice advice) const { file_.advise(advice); }
+  // Flushes inserts of a read-write mapping to the file.
+  void sync() const { file_.sync(); }
+
+  // Recomputes the checksum of a formatted file and compares it with the
+  // stored one. Reads the whole file.
+  bool verify() const {
+    assert(checksum_offset_ != 0);
+    crc_type stored;
+    std::memcpy(&stored, file_.data() + checksum_offset_, sizeof(stored));
+    return crc32c(file_.data(), checksum_offset_) == stored;
+  }
+  // Stores the checksum of the current contents of a formatted, writable file.
+  void update_checksum() {
+    assert(checksum_offset_ != 0);
+    require_writable();
+    const crc_type crc = crc32c(file_.data(), checksum_offset_);
+    std::memcpy(file_.data() + checksum_offset_, &crc, sizeof(crc));
+  }
+
+ private:
+  using crc_type = std::uint32_t;
+
+  mapped_bloom_filter(mapped_file file, HashGen hash_generator,
+                      std::size_t payload_offset)
+      : file_(std::move(file)), hash_generator_(std::move(hash_generator)) {
+    bind(payload_offset);
+  }
+
+  // Writing to a PROT_READ mapping would fault.
+  void require_writable() const {
+    if (!file_.writable())
+      throw std::logic_error("mapped_bloom_filter: read-only mapping");
+  }
+
+  void set_bits(const Key &key) noexcept {
+    for (auto hash : hash_generator_.hashes(key)) {
+      words_[hash >> bits_per_word_log2] |= word_type{1}
+                                            << (hash & word_mask);
+    }
+  }
+
+  void bind(std::size_t payload_offset) {
+    const auto words =
+        (hash_generator_.range() + bits_per_word - 1) / bits_per_word;
+    if (payload_offset % alignof(word_type) != 0)
+      throw std::invalid_argument("misaligned bloom filter payload");
+    if (file_.size() < payload_offset + words * sizeof(word_type))
+      throw std::length_error("file too small for bloom filter");
+    words_ = {reinterpret_cast<word_type *>(file_.data() + payload_offset),
+              words};
+  }
+
+  mapped_file file_;
+  std::span<word_type> words_;
+  hash_generator_type hash_generator_;
+  // Offset of the trailing checksum, 0 for raw bit arrays.
+  std::size_t checksum_offset_ = 0;
+};
+
+}  // namespace pds
+#endif
@@ -0,0 +1,157 @@
+#ifndef PDS_MAPPED_FILE_HPP
+#define PDS_MAPPED_FILE_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Thin RAII wrapper around a POSIX memory mapping of a whole file.
+
+namespace pds {
+
+enum class map_mode {
+  read_only,   // PROT_READ, MAP_PRIVATE
+  read_write,  // PROT_READ | PROT_WRITE, MAP_SHARED: writes reach the file
+};
+
+enum class access_advice { normal, random, sequential, will_need, dont_need };
+
+struct map_options {
+  map_mode mode = map_mode::read_only;
+  // Prefault every page at map time (MAP_POPULATE) instead of paging in on
+  // first touch. Ignored where the flag does not exist.
+  bool populate = false;
+  access_advice advice = access_advice::random;
+};
+
+class mapped_file {
+ public:
+  mapped_file() = default;
+  mapped_file(const std::string &path, const map_options &options = {})
+      : mode_{options.mode} {
+    const int fd = ::open(path.c_str(), options.mode == map_mode::read_write
+                                            ? O_RDWR
+                                            : O_RDONLY);
+    if (fd < 0) throw_errno("open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) fail(fd, "fstat " + path);
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ != 0) map(fd, options);
+    ::close(fd);
+    // The destructor does not run if the constructor throws.
+    try {
+      advise(options.advice);
+    } catch (...) {
+      unmap();
+      throw;
+    }
+  }
+  // Creates (or truncates) path to size zero-filled bytes and maps it
+  // read-write.
+  static mapped_file create(const std::string &path, std::size_t size,
+                            const map_options &options = {}) {
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw_errno("open " + path);
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+      fail(fd, "ftruncate " + path);
+    ::close(fd);
+    auto rw = options;
+    rw.mode = map_mode::read_write;
+    return mapped_file(path, rw);
+  }
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+  mapped_file(mapped_file &&other) noexcept
+      : data_{std::exchange(other.data_, nullptr)},
+        size_{std::exchange(other.size_, 0)},
+        mode_{other.mode_} {}
+  mapped_file &operator=(mapped_file &&other) noexcept {
+    if (this != &other) {
+      unmap();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+      mode_ = other.mode_;
+    }
+    return *this;
+  }
+  ~mapped_file() { unmap(); }
+
+  std::byte *data() noexcept { return static_cast<std::byte *>(data_); }
+  const std::byte *data() const noexcept {
+    return static_cast<const std::byte *>(data_);
+  }
+  std::size_t size() const noexcept { return size_; }
+  map_mode mode() const noexcept { return mode_; }
+  bool writable() const noexcept { return mode_ == map_mode::read_write; }
+
+  void advise(access_advice advice) const {
+    if (!data_) return;
+    if (::madvise(data_, size_, to_native(advice)) != 0) throw_errno("madvise");
+  }
+  // Flushes dirty pages of a read-write mapping to the file.
+  void sync() const {
+    if (data_ && writable() && ::msync(data_, size_, MS_SYNC) != 0)
+      throw_errno("msync");
+  }
+
+ private:
+  void map(int fd, const map_options &options) {
+    int prot = PROT_READ;
+    int flags = MAP_PRIVATE;
+    if (options.mode == map_mode::read_write) {
+      prot |= PROT_WRITE;
+      flags = MAP_SHARED;
+    }
+#ifdef MAP_POPULATE
+    if (options.populate) flags |= MAP_POPULATE;
+#endif
+    data_ = ::mmap(nullptr, size_, prot, flags, fd, 0);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      fail(fd, "mmap");
+    }
+  }
+  void unmap() noexcept {
+    if (data_) ::munmap(data_, size_);
+    data_ = nullptr;
+  }
+  static int to_native(access_advice advice) noexcept {
+    switch (advice) {
+      case access_advice::random:
+        return MADV_RANDOM;
+      case access_advice::sequential:
+        return MADV_SEQUENTIAL;
+      case access_advice::will_need:
+        return MADV_WILLNEED;
+      case access_advice::dont_need:
+        return MADV_DONTNEED;
+      case access_advice::normal:
+        break;
+    }
+    return MADV_NORMAL;
+  }
+  [[noreturn]] static void throw_errno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+  }
+  // Closes fd without losing the errno of the call that failed.
+  [[noreturn]] static void fail(int fd, const std::string &what) {
+    const int error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), what);
+  }
+
+  void *data_ = nullptr;
+  std::size_t size_ = 0;
+  map_mode mode_ = map_mode::read_only;
+};
+
+}  // namespace pds
+#endif
@@ -0,0 +1,133 @@
+#ifndef PDS_PARALLEL_BUILD_HPP
+#define PDS_PARALLEL_BUILD_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Multi-threaded bulk insertion into a bit array. The input is split evenly
+// across threads and processed in rounds: in the hash phase every thread
+// hashes a chunk of its keys and radix-partitions the resulting bit positions
+// by region; in the set phase thread r applies every thread's positions for
+// region r. A region is owned by one thread during the set phase, so the
+// writes need no atomics, stay within a contiguous part of the array, and the
+// result is the same as a sequential build, since setting bits commutes.
+
+namespace pds {
+namespace parallel_build {
+
+// Keys hashed per thread and round; bounds the partition buffers to about
+// chunk_keys * k positions per thread.
+inline constexpr std::size_t chunk_keys = std::size_t{1} << 16;
+// Below this many keys per thread, starting threads costs more than it saves.
+inline constexpr std::size_t min_keys_per_thread = std::size_t{1} << 12;
+// Regions start on cache line boundaries so threads never share a line.
+inline constexpr std::size_t region_alignment_bits = 512;
+
+inline unsigned default_threads() noexcept {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// positions(key, out) writes the k bit indices of key to out; set(bit) sets
+// one bit. set is only ever called for bits of one region per thread. If
+// either throws, or a thread cannot be started, the other threads stop at
+// the next phase and the first exception is rethrown once all have joined;
+// the bit array is then partially built.
+template <std::random_access_iterator It, typename Positions, typename Set>
+void set_bits(It first, It last, std::size_t num_bits, std::size_t k,
+              unsigned num_threads, Positions positions, Set set) {
+  const auto n = static_cast<std::size_t>(last - first);
+  num_threads = static_cast<unsigned>(std::clamp<std::size_t>(
+      num_threads, 1, std::max<std::size_t>(1, n / min_keys_per_thread)));
+  if (num_threads == 1 || k == 0) {
+    std::vector<std::size_t> buffer(k);
+    for (auto it = first; it != last; ++it) {
+      positions(*it, buffer.data());
+      for (auto bit : buffer) set(bit);
+    }
+    return;
+  }
+
+  const std::size_t region_bits =
+      (num_bits / num_threads + region_alignment_bits) /
+      region_alignment_bits * region_alignment_bits;
+  const std::size_t per_thread = (n + num_threads - 1) / num_threads;
+  const std::size_t rounds = (per_thread + chunk_keys - 1) / chunk_keys;
+
+  // buckets[t * num_threads + r]: positions hashed by thread t in region r.
+  std::vector<std::vector<std::size_t>> buckets(std::size_t{num_threads} *
+                                                num_threads);
+  std::barrier sync(num_threads);
+
+  // A thread that leaves early drops out of the barrier, so the others never
+  // wait for it.
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto fail = [&](std::exception_ptr e) {
+    std::lock_guard lock(error_mutex);
+    if (!error) error = std::move(e);
+    failed.store(true);
+  };
+
+  auto worker = [&](unsigned t) {
+    try {
+      std::vector<std::size_t> buffer(k);
+      const std::size_t begin = std::min(n, t * per_thread);
+      const std::size_t end = std::min(n, begin + per_thread);
+      for (std::size_t round = 0; round < rounds; ++round) {
+        if (failed.load()) {
+          sync.arrive_and_drop();
+          return;
+        }
+        const std::size_t lo = std::min(end, begin + round * chunk_keys);
+        const std::size_t hi = std::min(end, lo + chunk_keys);
+        for (unsigned r = 0; r < num_threads; ++r)
+          buckets[t * num_threads + r].clear();
+        for (std::size_t i = lo; i < hi; ++i) {
+          positions(first[i], buffer.data());
+          for (auto bit : buffer)
+            buckets[t * num_threads + bit / region_bits].push_back(bit);
+        }
+        sync.arrive_and_wait();
+        if (failed.load()) {
+          sync.arrive_and_drop();
+          return;
+        }
+        for (unsigned s = 0; s < num_threads; ++s) {
+          for (auto bit : buckets[s * num_threads + t]) set(bit);
+        }
+        sync.arrive_and_wait();
+      }
+    } catch (...) {
+      fail(std::current_exception());
+      sync.arrive_and_drop();
+    }
+  };
+
+  std::vector<std::jthread> threads;
+  threads.reserve(num_threads - 1);
+  for (unsigned t = 1; t < num_threads; ++t) {
+    try {
+      threads.emplace_back(worker, t);
+    } catch (...) {
+      fail(std::current_exception());
+      // Arrive in place of the threads that never started.
+      for (; t < num_threads; ++t) sync.arrive_and_drop();
+      break;
+    }
+  }
+  worker(0);
+  threads.clear();
+  if (error) std::rethrow_exception(error);
+}
+
+}  // namespace parallel_build
+}  // namespace pds
+#endif
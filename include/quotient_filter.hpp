@@ -1,103 +1,1006 @@
 #ifndef PDS_QUOTIENT_FILTER_HPP
 #define PDS_QUOTIENT_FILTER_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
 #include "hash.hpp"
+#include "simd.hpp"
+
+// Rank-and-select quotient filter (Pandey et al., "A General-Purpose
+// Counting Filter: Making Every Bit Count"). A key's hash is split into a
+// q-bit quotient, its home slot among 2^q, and an r-bit remainder stored in
+// or after that slot. The remainders of one quotient form a sorted run and
+// runs are kept in quotient order, so a run is pushed right only by the runs
+// before it.
+//
+// Slots are grouped in blocks of 64. Each block holds an occupieds word (bit
+// i: some key has quotient 64b + i), a runends word (bit i: slot 64b + i
+// ends a run), the number of slots at its start taken by runs of earlier
+// quotients, and its 64 remainders packed r bits apiece. A lookup ranks its
+// quotient in the occupieds word and selects the matching run end from the
+// offset on, which stays in the same or the next block, instead of walking
+// the cluster as a classic quotient filter does. Runs never wrap around;
+// slack blocks after the last home slot absorb the runs that spill over.
+//
+// The filter counts: each distinct fingerprint is stored once with its
+// count, in line in its run with a variable-length encoding. Counts of one
+// and two take one and two slots, larger ones a slot per base 2^r - 1 digit
+// plus two or four, so a skewed multiset costs little more than its set of
+// distinct keys and count() reads the same one or two cache lines as
+// contains(). Counts are exact up to fingerprint collisions, which only
+// ever overcount. Erasing a key that was never inserted can remove the
+// count of another one and so introduce a false negative. The false
+// positive probability is about num_fingerprints() / num_slots() * 2^-r.
 
 namespace pds {
-template <class Key, class Hash = pds::hash::default_hash<Key>,
-          class Container = std::vector<unsigned int>>
+
+namespace quotient_detail {
+
+// Position of the k-th (from 0) set bit of x, for k < popcount(x). Without
+// BMI2, the byte holding it is found from the prefix popcounts of all bytes
+// at once (Vigna, "Broadword implementation of rank/select queries").
+inline unsigned select64(std::uint64_t x, unsigned k) noexcept {
+#if defined(__BMI2__)
+  return static_cast<unsigned>(
+      std::countr_zero(_pdep_u64(std::uint64_t{1} << k, x)));
+#else
+  constexpr std::uint64_t ones = 0x0101010101010101ULL;
+  std::uint64_t s = x - ((x >> 1) & 0x5555555555555555ULL);
+  s = (s & 0x3333333333333333ULL) + ((s >> 2) & 0x3333333333333333ULL);
+  s = ((s + (s >> 4)) & 0x0f0f0f0f0f0f0f0fULL) * ones;
+  // Byte i of s is the popcount of bytes 0 through i; count those <= k.
+  const std::uint64_t at_most_k =
+      ((k * ones | 0x8080808080808080ULL) - s) & 0x8080808080808080ULL;
+  const auto shift = static_cast<unsigned>(((at_most_k >> 7) * ones) >> 56) * 8;
+  k -= static_cast<unsigned>(((s << 8) >> shift) & 0xff);
+  auto byte = static_cast<unsigned>((x >> shift) & 0xff);
+  for (; k > 0; --k) byte &= byte - 1;
+  return shift + static_cast<unsigned>(std::countr_zero(byte));
+#endif
+}
+
+// Every word of the table is read and written through these, as relaxed
+// atomics, so that the lock-free lookups of a concurrent_quotient_filter may
+// race with a writer without undefined behaviour. On the usual targets they
+// compile to plain loads and stores.
+static_assert(std::atomic_ref<std::uint64_t>::is_always_lock_free);
+inline std::uint64_t load(const std::uint64_t &word) noexcept {
+  // atomic_ref needs a non-const referent even for loads.
+  return std::atomic_ref<std::uint64_t>(const_cast<std::uint64_t &>(word))
+      .load(std::memory_order_relaxed);
+}
+inline void store(std::uint64_t &word, std::uint64_t value) noexcept {
+  std::atomic_ref<std::uint64_t>(word).store(value, std::memory_order_relaxed);
+}
+
+// Bits 0 through i of a word.
+inline std::uint64_t mask_through(unsigned i) noexcept {
+  return ~std::uint64_t{0} >> (63 - i);
+}
+
+// Bits [first, last) of a word, for first < last <= 64.
+inline std::uint64_t mask_range(unsigned first, unsigned last) noexcept {
+  return (~std::uint64_t{0} >> (64 - (last - first))) << first;
+}
+
+// Moves bits [first, last) of a packed array up by 0 < n < 64 bits, leaving
+// the bits below first + n other than the moved ones untouched. Words are
+// rewritten from the top so each reads its lower neighbour before it
+// changes.
+inline void shift_bits_up(std::uint64_t *a, std::size_t first,
+                          std::size_t last, unsigned n) noexcept {
+  if (first >= last) return;
+  for (std::size_t w = (last + n - 1) / 64 + 1; w-- > (first + n) / 64;) {
+    std::uint64_t moved = load(a[w]) << n;
+    if (w * 64 > first) moved |= load(a[w - 1]) >> (64 - n);
+    const auto lo = static_cast<unsigned>(std::max(first + n, w * 64) - w * 64);
+    const auto hi =
+        static_cast<unsigned>(std::min(last + n, w * 64 + 64) - w * 64);
+    const std::uint64_t mask = mask_range(lo, hi);
+    store(a[w], (load(a[w]) & ~mask) | (moved & mask));
+  }
+}
+// Moves bits [first, last) down by 0 < n <= first bits, from the bottom.
+inline void shift_bits_down(std::uint64_t *a, std::size_t first,
+                            std::size_t last, unsigned n) noexcept {
+  if (first >= last) return;
+  for (std::size_t w = (first - n) / 64; w <= (last - n - 1) / 64; ++w) {
+    std::uint64_t moved = load(a[w]) >> n;
+    if ((w + 1) * 64 < last) moved |= load(a[w + 1]) << (64 - n);
+    const auto lo = static_cast<unsigned>(std::max(first - n, w * 64) - w * 64);
+    const auto hi =
+        static_cast<unsigned>(std::min(last - n, w * 64 + 64) - w * 64);
+    const std::uint64_t mask = mask_range(lo, hi);
+    store(a[w], (load(a[w]) & ~mask) | (moved & mask));
+  }
+}
+
+}  // namespace quotient_detail
+
+template <typename Key, hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>,
+          typename Allocator = std::allocator<unsigned long>>
 class quotient_filter {
  public:
-  // assert or trait that these are unsigned
+  using key_type = Key;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using hash_function_type = Hash;
   using seed_type = typename Hash::seed_type;
   using hash_type = typename Hash::hash_type;
 
-  quotient_filter(size_t num_bits_quotient, size_t num_bits_remainder,
-                  Seed seed)
-      : _table(std::pow(2, num_bits_quotient), 0), _seed{seed} {
-    assert(num_bits_quotient + num_bits_remainder ==
-               std::numeric_limits<hash_type>::digits,
-           "q+r must equal num bits in underlying type");
+  static_assert(std::numeric_limits<hash_type>::digits >= 64,
+                "quotient filters need a 64-bit hash");
+
+  static constexpr size_type slots_per_block = 64;
+  // Inserts slow down sharply above this load as clusters grow long.
+  static constexpr double default_max_load_factor = 0.95;
+
+  // 2^num_bits_quotient home slots holding num_bits_remainder bits each;
+  // the two take the high bits of the key's hash and may not exceed 64.
+  quotient_filter(size_type num_bits_quotient, size_type num_bits_remainder,
+                  seed_type seed = 0, const Allocator &alloc = Allocator())
+      : words_(word_allocator(alloc)),
+        quotient_bits_{num_bits_quotient},
+        remainder_bits_{num_bits_remainder},
+        seed_{seed} {
+    if (num_bits_quotient == 0 || num_bits_remainder < 2 ||
+        num_bits_quotient + num_bits_remainder > 64)
+      throw std::invalid_argument(
+          "quotient_filter: need q > 0, r > 1 and q + r <= 64");
+    if (num_bits_quotient > 40)
+      throw std::length_error("quotient_filter: too many slots");
+    const size_type home_slots = size_type{1} << quotient_bits_;
+    const auto slack = std::max<size_type>(
+        slots_per_block,
+        static_cast<size_type>(10 * std::sqrt(static_cast<double>(home_slots))));
+    num_blocks_ = (home_slots + slack + slots_per_block - 1) / slots_per_block;
+    words_.assign(num_blocks_ * block_words(), 0);
+  }
+  // Sized for input_size keys at false_positive_probability, with the
+  // default maximum load factor.
+  quotient_filter(size_type input_size, double false_positive_probability,
+                  seed_type seed = 0, const Allocator &alloc = Allocator())
+      : quotient_filter(quotient_bits_for(input_size),
+                        remainder_bits_for(false_positive_probability), seed,
+                        alloc) {}
+
+  template <std::input_iterator It>
+  void insert(It first, It last) {
+    for (auto it = first; it != last; ++it) insert(*it);
+  }
+  // Adds count copies of the key. Throws std::length_error once capacity()
+  // slots are in use, leaving the filter unchanged.
+  void insert(const Key &key, std::uint64_t count = 1) {
+    insert_hash(hash_of(key), count);
+  }
+
+  bool contains(const Key &key) const noexcept {
+    return contains_hash(hash_of(key));
+  }
+  // Number of copies of the key, or more if other keys share its
+  // fingerprint.
+  std::uint64_t count(const Key &key) const noexcept {
+    return count_hash(hash_of(key));
+  }
+  template <hash::TransparentKey<Key> K>
+    requires std::invocable<Hash, const K &, seed_type>
+  bool contains(const K &key) const noexcept {
+    return contains_hash(static_cast<std::uint64_t>(Hash{}(key, seed_)));
+  }
+  // Lookup by the key's Hash output under seed().
+  bool contains_hash(std::uint64_t key_hash) const noexcept {
+    return count_hash(key_hash) != 0;
+  }
+  template <hash::TransparentKey<Key> K>
+    requires std::invocable<Hash, const K &, seed_type>
+  std::uint64_t count(const K &key) const noexcept {
+    return count_hash(static_cast<std::uint64_t>(Hash{}(key, seed_)));
+  }
+  std::uint64_t count_hash(std::uint64_t key_hash) const noexcept {
+    const auto [quotient, remainder] = split(key_hash);
+    if (!occupied(quotient)) return 0;
+    const size_type end = run_end_next(quotient) - 1;
+    for (size_type slot = run_start(quotient, end); slot <= end;) {
+      const entry e = decode(slot, end);
+      if (e.remainder >= remainder)
+        return e.remainder == remainder ? e.count : 0;
+      slot += e.length;
+    }
+    return 0;
+  }
+
+  // Removes one copy of the key and returns whether there was one. Only
+  // erase keys that were inserted.
+  bool erase(const Key &key) noexcept { return erase_hash(hash_of(key), 1); }
+  // Removes up to count copies of the key and returns how many it removed.
+  std::uint64_t erase(const Key &key, std::uint64_t count) noexcept {
+    return erase_hash(hash_of(key), count);
+  }
+
+  void clear() noexcept {
+    std::fill(words_.begin(), words_.end(), 0);
+    size_ = 0;
+    num_fingerprints_ = 0;
+    slots_used_ = 0;
+  }
+
+  // Number of keys stored, counting copies.
+  size_type size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  // Number of distinct fingerprints stored.
+  size_type num_fingerprints() const noexcept { return num_fingerprints_; }
+  // Number of home slots, 2^quotient_bits().
+  size_type num_slots() const noexcept {
+    return size_type{1} << quotient_bits_;
+  }
+  // Slots holding remainders or counter digits.
+  size_type slots_used() const noexcept { return slots_used_; }
+  // Number of slots in use at which inserts start to throw.
+  size_type capacity() const noexcept {
+    return static_cast<size_type>(max_load_factor_ *
+                                  static_cast<double>(num_slots()));
+  }
+  double load_factor() const noexcept {
+    return static_cast<double>(slots_used_) /
+           static_cast<double>(num_slots());
+  }
+  double max_load_factor() const noexcept { return max_load_factor_; }
+  void max_load_factor(double load) {
+    if (!(load > 0 && load <= 1))
+      throw std::invalid_argument("quotient_filter: bad load factor");
+    max_load_factor_ = load;
+  }
+  double false_positive_probability() const noexcept {
+    return -std::expm1(-static_cast<double>(num_fingerprints_) /
+                       static_cast<double>(num_slots()) /
+                       std::ldexp(1.0, static_cast<int>(remainder_bits_)));
+  }
+
+  size_type quotient_bits() const noexcept { return quotient_bits_; }
+  size_type remainder_bits() const noexcept { return remainder_bits_; }
+  size_type size_in_bytes() const noexcept {
+    return words_.size() * sizeof(std::uint64_t);
+  }
+  seed_type seed() const noexcept { return seed_; }
+
+  // Doubles the number of home slots without the original keys: the top
+  // bit of every remainder moves into its quotient, which keeps entries in
+  // the same order, so the old table is read and the new one written in
+  // one sequential pass. Keys keep their counts and lookups keep finding
+  // them; the false positive rate is unchanged at first and doubles once
+  // the filter fills up again. Throws std::length_error if remainders are
+  // down to two bits or the filter would exceed 2^40 home slots, leaving it
+  // unchanged.
+  void expand() {
+    if (remainder_bits_ <= 2)
+      throw std::length_error("quotient_filter: remainders too short to expand");
+    quotient_filter expanded(quotient_bits_ + 1, remainder_bits_ - 1, seed_,
+                             Allocator(words_.get_allocator()));
+    expanded.max_load_factor_ = max_load_factor_;
+    sequential_writer writer(expanded);
+    for (entry_reader in(*this); !in.done(); in.advance())
+      writer.add(in.fingerprint(), in.count());
+    writer.finish();
+    *this = std::move(expanded);
+  }
+
+  // Replaces the contents with the keys whose Hash outputs under seed() are
+  // in hashes, sorted in increasing order; equal fingerprints are counted
+  // once per occurrence. One sequential pass writes every slot once, where
+  // inserting them one by one shifts runs around at random. Throws
+  // std::invalid_argument if hashes are not sorted and std::length_error
+  // past capacity(), leaving the filter empty.
+  void build_from_sorted(std::span<const std::uint64_t> hashes) {
+    const size_type shift = 64 - fingerprint_bits();
+    rebuild([&](sequential_writer &writer) {
+      std::uint64_t previous = 0;
+      for (const std::uint64_t h : hashes) {
+        if (h < previous)
+          throw std::invalid_argument("quotient_filter: hashes not sorted");
+        previous = h;
+        writer.add(h >> shift, 1);
+      }
+    });
+  }
+
+  // Replaces the contents with the union of a and b, summing the counts of
+  // fingerprints in both, by merging their entries as two sorted runs in one
+  // sequential pass. The inputs may have any geometry with at least
+  // quotient_bits() + remainder_bits() bits in total, as after expand(),
+  // and must share seed(); fingerprints they tell apart but this filter
+  // cannot are counted together. Either may be *this. Throws
+  // std::invalid_argument on mismatched inputs and std::length_error past
+  // capacity(), leaving the filter empty.
+  quotient_filter &merge(const quotient_filter &a, const quotient_filter &b) {
+    if (a.seed_ != seed_ || b.seed_ != seed_ ||
+        a.fingerprint_bits() < fingerprint_bits() ||
+        b.fingerprint_bits() < fingerprint_bits())
+      throw std::invalid_argument("quotient_filter: filters do not match");
+    if (this == &a || this == &b) {
+      quotient_filter merged(quotient_bits_, remainder_bits_, seed_,
+                             Allocator(words_.get_allocator()));
+      merged.max_load_factor_ = max_load_factor_;
+      merged.merge(a, b);
+      return *this = std::move(merged);
+    }
+    const size_type a_shift = a.fingerprint_bits() - fingerprint_bits();
+    const size_type b_shift = b.fingerprint_bits() - fingerprint_bits();
+    rebuild([&](sequential_writer &writer) {
+      entry_reader in_a(a), in_b(b);
+      while (!in_a.done() || !in_b.done()) {
+        const bool take_a =
+            !in_a.done() &&
+            (in_b.done() || in_a.fingerprint() >> a_shift <=
+                                in_b.fingerprint() >> b_shift);
+        auto &in = take_a ? in_a : in_b;
+        writer.add(in.fingerprint() >> (take_a ? a_shift : b_shift),
+                   in.count());
+        in.advance();
+      }
+    });
+    return *this;
+  }
+
+  static size_type quotient_bits_for(size_type input_size) noexcept {
+    const double slots = static_cast<double>(input_size) / default_max_load_factor;
+    return std::max<size_type>(
+        1, static_cast<size_type>(std::ceil(std::log2(std::max(slots, 1.0)))));
+  }
+  static size_type remainder_bits_for(double false_positive_probability) {
+    if (!(false_positive_probability > 0 && false_positive_probability < 1))
+      throw std::invalid_argument("quotient_filter: bad false positive rate");
+    return std::max<size_type>(
+        2, static_cast<size_type>(
+               std::ceil(std::log2(1.0 / false_positive_probability))));
+  }
+
+ private:
+  template <typename K, hash::HashFunction<K> H, typename A>
+  friend class concurrent_quotient_filter;
+
+  using word_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<std::uint64_t>;
+
+  // Block layout, in 64-bit words.
+  static constexpr size_type offset_word = 0;
+  static constexpr size_type occupieds_word = 1;
+  static constexpr size_type runends_word = 2;
+  static constexpr size_type remainders_word = 3;
+
+  std::uint64_t hash_of(const Key &key) const noexcept {
+    return static_cast<std::uint64_t>(Hash{}(key, seed_));
+  }
+  std::pair<size_type, std::uint64_t> split(std::uint64_t h) const noexcept {
+    const size_type quotient = h >> (64 - quotient_bits_);
+    const std::uint64_t remainder =
+        (h >> (64 - quotient_bits_ - remainder_bits_)) & remainder_mask();
+    return {quotient, remainder};
+  }
+  std::uint64_t remainder_mask() const noexcept {
+    return ~std::uint64_t{0} >> (64 - remainder_bits_);
+  }
+
+  size_type block_words() const noexcept {
+    return remainders_word + remainder_bits_;
+  }
+  size_type total_slots() const noexcept {
+    return num_blocks_ * slots_per_block;
+  }
+  std::uint64_t *block(size_type b) noexcept {
+    return words_.data() + b * block_words();
+  }
+  const std::uint64_t *block(size_type b) const noexcept {
+    return words_.data() + b * block_words();
+  }
+  std::uint64_t &word_ref(size_type slot, size_type which) noexcept {
+    return block(slot / slots_per_block)[which];
+  }
+  std::uint64_t word(size_type slot, size_type which) const noexcept {
+    return quotient_detail::load(block(slot / slots_per_block)[which]);
+  }
+  static std::uint64_t bit(size_type slot) noexcept {
+    return std::uint64_t{1} << (slot % slots_per_block);
+  }
+  bool occupied(size_type slot) const noexcept {
+    return word(slot, occupieds_word) & bit(slot);
+  }
+  bool runend(size_type slot) const noexcept {
+    return word(slot, runends_word) & bit(slot);
+  }
+  void set_occupied(size_type slot, bool value) noexcept {
+    set_bit(word_ref(slot, occupieds_word), bit(slot), value);
+  }
+  void set_runend(size_type slot, bool value) noexcept {
+    set_bit(word_ref(slot, runends_word), bit(slot), value);
+  }
+  static void set_bit(std::uint64_t &w, std::uint64_t mask,
+                      bool value) noexcept {
+    const std::uint64_t old = quotient_detail::load(w);
+    quotient_detail::store(w, value ? old | mask : old & ~mask);
+  }
+
+  std::uint64_t remainder_at(size_type slot) const noexcept {
+    const std::uint64_t *packed =
+        block(slot / slots_per_block) + remainders_word;
+    const size_type first = (slot % slots_per_block) * remainder_bits_;
+    const auto shift = static_cast<unsigned>(first % 64);
+    std::uint64_t value = quotient_detail::load(packed[first / 64]) >> shift;
+    if (shift + remainder_bits_ > 64)
+      value |= quotient_detail::load(packed[first / 64 + 1]) << (64 - shift);
+    return value & remainder_mask();
   }
-  template <class InputIt>
-  void insert(InputIt first, InputIt last) noexcept {
-    for (auto it = first; it != last; ++it) {
-      insert(*it);
+  void set_remainder(size_type slot, std::uint64_t value) noexcept {
+    std::uint64_t *packed = block(slot / slots_per_block) + remainders_word;
+    const size_type first = (slot % slots_per_block) * remainder_bits_;
+    const auto shift = static_cast<unsigned>(first % 64);
+    const std::uint64_t mask = remainder_mask();
+    std::uint64_t &low = packed[first / 64];
+    quotient_detail::store(
+        low, (quotient_detail::load(low) & ~(mask << shift)) |
+                 (value << shift));
+    if (shift + remainder_bits_ > 64) {
+      std::uint64_t &high = packed[first / 64 + 1];
+      quotient_detail::store(high,
+                             (quotient_detail::load(high) &
+                              ~(mask >> (64 - shift))) |
+                                 (value >> (64 - shift)));
+    }
+  }
+  void move_slot(size_type from, size_type to) noexcept {
+    set_remainder(to, remainder_at(from));
+    set_runend(to, runend(from));
+  }
+  // Moves slots [first, last) up by one, a block at a time from the top: the
+  // remainders as one bit range of the packed words, the run ends as a range
+  // of the runends word, and the top slot of a block into the next one.
+  void shift_slots_up(size_type first, size_type last) noexcept {
+    if (first >= last) return;
+    const size_type r = remainder_bits_;
+    for (size_type b = last / slots_per_block + 1;
+         b-- > first / slots_per_block;) {
+      const size_type base = b * slots_per_block;
+      const size_type lo = std::max(first, base) - base;
+      size_type hi = std::min(last, base + slots_per_block) - base;
+      if (hi == slots_per_block) {
+        move_slot(base + slots_per_block - 1, base + slots_per_block);
+        --hi;
+      }
+      std::uint64_t *blk = block(b);
+      quotient_detail::shift_bits_up(blk + remainders_word, lo * r, hi * r,
+                                     static_cast<unsigned>(r));
+      quotient_detail::shift_bits_up(blk + runends_word, lo, hi, 1);
+    }
+  }
+  // Moves slots [first, last) down by one, a block at a time from the
+  // bottom. first must be positive.
+  void shift_slots_down(size_type first, size_type last) noexcept {
+    if (first >= last) return;
+    const size_type r = remainder_bits_;
+    for (size_type b = first / slots_per_block;
+         b <= (last - 1) / slots_per_block; ++b) {
+      const size_type base = b * slots_per_block;
+      size_type lo = std::max(first, base) - base;
+      const size_type hi = std::min(last, base + slots_per_block) - base;
+      if (lo == 0) {
+        move_slot(base, base - 1);
+        lo = 1;
+      }
+      std::uint64_t *blk = block(b);
+      quotient_detail::shift_bits_down(blk + remainders_word, lo * r, hi * r,
+                                       static_cast<unsigned>(r));
+      quotient_detail::shift_bits_down(blk + runends_word, lo, hi, 1);
     }
   }
-  void insert(const Key &key) {
-    assert(_size < _table.size());
-    auto [quotient, remainder] = divide(Hash{}(key, _seed));
-    auto quotient_seen = _bucket_occupied[quotient];
-    if (!quotient_seen) _bucket_occupied[quotient] = true;
 
-    if (!quotient_seen && !_is_shifted[quotient]) {
-      // insert in canonical slot if it is empty
-      _bucket_occupied[quotient] = true;
-      _table[quotient] = remainder;
-    } else if (quotient_seen && !_is_shifted[quotient]) {
-      // start of cluster
+  // Slot of the rank-th (from 0) run end at or after from. The scan stops
+  // at the last slot, which keeps lookups racing with a writer of a
+  // concurrent_quotient_filter in bounds.
+  size_type select_runend(size_type from, size_type rank) const noexcept {
+    size_type b = from / slots_per_block;
+    std::uint64_t ends = quotient_detail::load(block(b)[runends_word]) &
+                         (~std::uint64_t{0} << (from % slots_per_block));
+    while (true) {
+      const auto count = static_cast<size_type>(std::popcount(ends));
+      if (rank < count)
+        return b * slots_per_block +
+               quotient_detail::select64(ends, static_cast<unsigned>(rank));
+      rank -= count;
+      if (++b == num_blocks_) return total_slots() - 1;
+      ends = quotient_detail::load(block(b)[runends_word]);
+    }
+  }
+  // One past the end of the last run of a quotient up to and including x.
+  // Slot x is in use iff this exceeds x, and if x is occupied its run ends
+  // just before it. Runs ending before x's block only give a lower bound.
+  size_type run_end_next(size_type x) const noexcept {
+    const size_type b = x / slots_per_block;
+    const std::uint64_t *blk = block(b);
+    const size_type start =
+        b * slots_per_block + quotient_detail::load(blk[offset_word]);
+    const auto rank = static_cast<size_type>(std::popcount(
+        quotient_detail::load(blk[occupieds_word]) &
+        quotient_detail::mask_through(
+            static_cast<unsigned>(x % slots_per_block))));
+    return rank ? select_runend(start, rank - 1) + 1 : start;
+  }
+  // First slot of the run ending at end, for an occupied quotient: the one
+  // after the previous run end, but not before the quotient.
+  size_type run_start(size_type quotient, size_type end) const noexcept {
+    size_type b = end / slots_per_block;
+    std::uint64_t ends =
+        quotient_detail::load(block(b)[runends_word]) & (bit(end) - 1);
+    while (!ends && b * slots_per_block > quotient)
+      ends = quotient_detail::load(block(--b)[runends_word]);
+    if (!ends) return quotient;
+    return std::max(quotient, b * slots_per_block + 64 -
+                                  static_cast<size_type>(std::countl_zero(ends)));
+  }
+  // First empty slot at or after from, or total_slots() if there is none.
+  size_type first_empty_slot(size_type from) const noexcept {
+    while (from < total_slots()) {
+      const size_type next = run_end_next(from);
+      if (next <= from) return from;
+      from = next;
+    }
+    return total_slots();
+  }
+  // Every block after the quotient's, through the one holding slot last,
+  // gains or loses one slot taken by earlier runs.
+  void adjust_offsets(size_type quotient, size_type last,
+                      std::uint64_t delta) noexcept {
+    for (size_type b = quotient / slots_per_block + 1;
+         b <= last / slots_per_block; ++b) {
+      std::uint64_t &offset = block(b)[offset_word];
+      quotient_detail::store(offset, quotient_detail::load(offset) + delta);
+    }
+  }
 
-    } else if (quotient_seen && _is_shifted[quotient]) {
-      // find where run must start
+  // Opens an empty slot at slot by shifting everything up to the next empty
+  // slot up by one. The caller fixes the run end bits.
+  void insert_slot(size_type quotient, size_type slot) {
+    const size_type empty = first_empty_slot(slot);
+    if (empty == total_slots())
+      throw std::length_error("quotient_filter: out of slack slots");
+    shift_slots_up(slot, empty);
+    adjust_offsets(quotient, empty, 1);
+  }
+  // Last slot of the runs after the run of quotient ending at end that do
+  // not start at their home slot, or end if there are none.
+  size_type shifted_runs_end(size_type quotient, size_type end) const noexcept {
+    size_type gap = end;
+    for (size_type q = quotient + 1; q <= gap; ++q) {
+      const std::uint64_t later =
+          word(q, occupieds_word) & (~std::uint64_t{0} << (q % slots_per_block));
+      if (!later) {
+        q |= slots_per_block - 1;
+        continue;
+      }
+      q = q - q % slots_per_block +
+          static_cast<size_type>(std::countr_zero(later));
+      if (q > gap) break;
+      gap = select_runend(gap + 1, 0);
+    }
+    return gap;
+  }
+  // Removes slot from the run [start, end] of quotient. The following runs
+  // of the cluster move back one slot each, up to the first that already
+  // starts at its home slot; with the rest of this run, that is one
+  // contiguous range.
+  void remove_slot(size_type quotient, size_type slot, size_type start,
+                   size_type end) noexcept {
+    const size_type gap = shifted_runs_end(quotient, end);
+    shift_slots_down(slot + 1, gap + 1);
+    if (slot == end) {
+      if (start < end) {
+        set_runend(end - 1, true);
+      } else {
+        set_occupied(quotient, false);
+      }
+    }
+    set_remainder(gap, 0);
+    set_runend(gap, false);
+    adjust_offsets(quotient, gap, ~std::uint64_t{0});
+  }
 
-    } else if (_bucket_occupied[quotient] && _is_shifted[quotient]) {
-      // find location within run
+  // A remainder x with its count c, as stored in length slots from slot.
+  // c = 1 is [x] and c = 2 is [x, x]. Above that, the digits of c - 3 in
+  // base 2^r - 1, most significant first, go between [x, ..., x], stored
+  // so as to skip the value x and with a leading zero if needed to start
+  // below x: remainders rise along a run, so a drop marks a counter. For
+  // x = 0 they go between [0, 0, 0, ..., 0] plus one, which three zeros
+  // mark since two can only be a count of two.
+  struct entry {
+    size_type slot;
+    size_type length;
+    std::uint64_t remainder;
+    std::uint64_t count;
+  };
+  // Enough for 64-bit counts in base 3.
+  static constexpr size_type max_entry_slots = 48;
+  struct encoded_entry {
+    std::uint64_t slots[max_entry_slots];
+    size_type length = 0;
+  };
 
+  // Decodes the entry at slot of a run ending at end, reading no further.
+  entry decode(size_type slot, size_type end) const noexcept {
+    const std::uint64_t x = remainder_at(slot);
+    if (slot == end) return {slot, 1, x, 1};
+    const std::uint64_t y = remainder_at(slot + 1);
+    const std::uint64_t base = remainder_mask();
+    std::uint64_t value = 0;
+    size_type i;
+    if (x > 0) {
+      if (y > x) return {slot, 1, x, 1};
+      if (y == x) return {slot, 2, x, 2};
+      for (i = slot + 1; i < end; ++i) {
+        const std::uint64_t digit = remainder_at(i);
+        if (digit == x) break;
+        value = value * base + (digit < x ? digit : digit - 1);
+      }
     } else {
-      // if canonical slot is occupied get run location
-      auto i = (_bucket_occupied[quotient] && !_is_shifted[quotient])
-                   ? quotient
-                   : find_run(quotient);
-
-      if (_bucket_occupied[quotient]) {
-        // if _bucket_occupied then find location within run
-        while (remainder > _table[i++]) {
-          if (i == _table.size()) i = 0;
-        }
-        if (remainder == _table[i]) return;
+      if (y != 0) return {slot, 1, 0, 1};
+      if (slot + 1 == end || remainder_at(slot + 2) != 0)
+        return {slot, 2, 0, 2};
+      for (i = slot + 3; i < end; ++i) {
+        const std::uint64_t digit = remainder_at(i);
+        if (digit == 0) break;
+        value = value * base + digit - 1;
       }
-      if (_bucket_occupied[i] || _is_shifted[i]) {
-        // if destination is occupied then shift contents
-        auto end_i = end_of_cluster(i);
-        shift(i, end_i);
+    }
+    return {slot, i - slot + 1, x, value + 3};
+  }
+  encoded_entry encode(std::uint64_t x, std::uint64_t count) const noexcept {
+    encoded_entry e;
+    const auto push = [&e](std::uint64_t value) {
+      e.slots[e.length++] = value;
+    };
+    push(x);
+    if (count == 1) return e;
+    push(x);
+    if (count == 2) return e;
+    const std::uint64_t base = remainder_mask();
+    std::uint64_t digits[max_entry_slots];
+    size_type n = 0;
+    std::uint64_t value = count - 3;
+    if (x > 0) {
+      e.length = 1;
+      do {
+        digits[n++] = value % base;
+        value /= base;
+      } while (value);
+      if (digits[n - 1] >= x) digits[n++] = 0;
+      while (n) {
+        const std::uint64_t digit = digits[--n];
+        push(digit < x ? digit : digit + 1);
       }
-      _table[i] = remainder;
-      _bucket_occupied[quotient] = true;
-      if (i != quotient) _is_shifted[i] = true;
-      if (i != run_begin)
+      push(x);
+    } else {
+      push(0);
+      for (; value; value /= base) digits[n++] = value % base;
+      while (n) push(digits[--n] + 1);
+      push(0);
+    }
+    return e;
+  }
 
-        // otherwise it is where the run must begin
+  // Entries of a filter in increasing (quotient, remainder) order.
+  class entry_reader {
+   public:
+    explicit entry_reader(const quotient_filter &filter) noexcept
+        : filter_{filter}, occupieds_{filter.word(0, occupieds_word)} {
+      next_run();
+    }
 
-        if (!bucket_occupied[quotient]) {
-          *run_begin = remai
-        }
+    bool done() const noexcept { return block_ == filter_.num_blocks_; }
+    // The entry's quotient and remainder as one q + r bit value.
+    std::uint64_t fingerprint() const noexcept {
+      return (std::uint64_t{quotient_} << filter_.remainder_bits_) |
+             entry_.remainder;
+    }
+    std::uint64_t count() const noexcept { return entry_.count; }
+    void advance() noexcept {
+      const size_type slot = entry_.slot + entry_.length;
+      if (slot <= end_) {
+        entry_ = filter_.decode(slot, end_);
+      } else {
+        next_run();
+      }
+    }
+
+   private:
+    void next_run() noexcept {
+      while (!occupieds_) {
+        if (++block_ == filter_.num_blocks_) return;
+        occupieds_ = filter_.word(block_ * slots_per_block, occupieds_word);
+      }
+      quotient_ = block_ * slots_per_block +
+                  static_cast<size_type>(std::countr_zero(occupieds_));
+      occupieds_ &= occupieds_ - 1;
+      const size_type start = std::max(quotient_, end_ + 1);
+      end_ = filter_.select_runend(start, 0);
+      entry_ = filter_.decode(start, end_);
+    }
+
+    const quotient_filter &filter_;
+    std::uint64_t occupieds_;
+    size_type block_ = 0;
+    size_type quotient_ = 0;
+    // The current run ends at end_; before the first, end_ + 1 wraps to 0.
+    size_type end_ = ~size_type{0};
+    entry entry_{};
+  };
+
+  // Fills an empty filter from q + r bit fingerprints in increasing order,
+  // summing the counts of equal ones, run after run: each block's offset is
+  // set once every earlier quotient is placed, no slot is written twice and
+  // nothing is shifted.
+  class sequential_writer {
+   public:
+    explicit sequential_writer(quotient_filter &filter) noexcept
+        : filter_{filter} {}
+
+    // Throws std::invalid_argument if fingerprint is below the previous one
+    // and std::length_error past capacity() slots.
+    void add(std::uint64_t fingerprint, std::uint64_t count) {
+      if (count == 0) return;
+      if (pending_count_ && fingerprint == pending_) {
+        pending_count_ += count;
+        return;
+      }
+      if (pending_count_ && fingerprint < pending_)
+        throw std::invalid_argument("quotient_filter: hashes not sorted");
+      flush();
+      pending_ = fingerprint;
+      pending_count_ = count;
+    }
+    void finish() {
+      flush();
+      close_run();
+      set_offsets_through(filter_.total_slots());
     }
+
+   private:
+    void flush() {
+      if (!pending_count_) return;
+      const auto quotient =
+          static_cast<size_type>(pending_ >> filter_.remainder_bits_);
+      const std::uint64_t remainder = pending_ & filter_.remainder_mask();
+      if (filter_.slots_used_ >= filter_.capacity())
+        throw std::length_error("quotient_filter: load factor exceeded");
+      if (quotient != quotient_) {
+        close_run();
+        set_offsets_through(quotient);
+        next_free_ = std::max(next_free_, quotient);
+        filter_.set_occupied(quotient, true);
+        quotient_ = quotient;
+      }
+      const encoded_entry e = filter_.encode(remainder, pending_count_);
+      if (next_free_ + e.length > filter_.total_slots())
+        throw std::length_error("quotient_filter: out of slack slots");
+      for (size_type i = 0; i < e.length; ++i)
+        filter_.set_remainder(next_free_ + i, e.slots[i]);
+      next_free_ += e.length;
+      filter_.slots_used_ += e.length;
+      ++filter_.num_fingerprints_;
+      filter_.size_ += pending_count_;
+      pending_count_ = 0;
+    }
+    void close_run() noexcept {
+      if (next_free_ > 0) filter_.set_runend(next_free_ - 1, true);
+    }
+    // Blocks starting at or before slot follow only earlier quotients.
+    void set_offsets_through(size_type slot) noexcept {
+      for (; next_block_ < filter_.num_blocks_ &&
+             next_block_ * slots_per_block <= slot;
+           ++next_block_) {
+        const size_type base = next_block_ * slots_per_block;
+        quotient_detail::store(filter_.block(next_block_)[offset_word],
+                               next_free_ > base ? next_free_ - base : 0);
+      }
+    }
+
+    quotient_filter &filter_;
+    std::uint64_t pending_ = 0;
+    std::uint64_t pending_count_ = 0;
+    size_type quotient_ = ~size_type{0};
+    size_type next_free_ = 0;
+    size_type next_block_ = 0;
+  };
+
+  size_type fingerprint_bits() const noexcept {
+    return quotient_bits_ + remainder_bits_;
   }
-  bool contains(const Key &key) const noexcept {
-    for (const auto hash : _hash_generator.hashes(key)) {
-      if (!_bitset[hash % _bitset.size()]) return false;
+  // Clears the filter, fills it through a sequential_writer with fill, and
+  // clears it again if that throws.
+  template <typename F>
+  void rebuild(F &&fill) {
+    clear();
+    try {
+      sequential_writer writer(*this);
+      fill(writer);
+      writer.finish();
+    } catch (...) {
+      clear();
+      throw;
     }
-    return true;
   }
-  void clear() noexcept { _bitset.reset(); }
-  size_t size() const noexcept { return _bitset.size(); }
 
-  float load_factor() const noexcept {
-    return _bitset.count() / (float)_bitset.size();
+  // Rewrites the entry of old_length slots at slot, in the run [start, end]
+  // of quotient, as e: opening or removing slots at its end first, so that
+  // the run end bits and offsets stay consistent throughout. If opening
+  // slots throws, the run is restored before rethrowing.
+  void replace_entry(size_type quotient, size_type start, size_type end,
+                     size_type slot, size_type old_length,
+                     const encoded_entry &e) {
+    size_type length = old_length;
+    try {
+      for (; length < e.length; ++length) {
+        const size_type at = slot + length;
+        insert_slot(quotient, at);
+        if (at <= end) {
+          set_runend(at, false);
+        } else {
+          set_runend(end, false);
+          set_runend(at, true);
+        }
+        ++end;
+      }
+    } catch (...) {
+      for (; length > old_length; --length)
+        remove_slot(quotient, slot + old_length, start, end--);
+      throw;
+    }
+    for (; length > e.length; --length)
+      remove_slot(quotient, slot + e.length, start, end--);
+    for (size_type i = 0; i < e.length; ++i)
+      set_remainder(slot + i, e.slots[i]);
   }
 
-  HashGenerator hash_generator() const { return _hash_generator; }
+  // What an insert or erase did to the counters: the copies and slots it
+  // added or removed, and whether it added or removed the fingerprint.
+  struct change {
+    std::uint64_t count = 0;
+    size_type slots = 0;
+    bool fingerprint = false;
+  };
 
- private:
-  Container _table;
-  vector<bool> _bucket_occupied, _run_continued, _is_shifted;
-  unsigned int _r;
-  size_t _size;
-  Seed _seed;
-  auto divide(hash_type) {
-    return std::make_tuple(hash >> _r, hash & ((1 << r) - 1));
+  // Adds count > 0 copies of a fingerprint, leaving the counters alone.
+  change insert_fingerprint(size_type quotient, std::uint64_t remainder,
+                            std::uint64_t count) {
+    if (!occupied(quotient)) {
+      // A new run, after those of earlier quotients that reach this far.
+      const size_type slot = std::max(quotient, run_end_next(quotient));
+      insert_slot(quotient, slot);
+      set_runend(slot, true);
+      set_occupied(quotient, true);
+      const encoded_entry e = encode(remainder, count);
+      try {
+        replace_entry(quotient, slot, slot, slot, 1, e);
+      } catch (...) {
+        remove_slot(quotient, slot, slot, slot);
+        throw;
+      }
+      return {count, e.length, true};
+    }
+    const size_type end = run_end_next(quotient) - 1;
+    const size_type start = run_start(quotient, end);
+    size_type slot = start;
+    while (slot <= end) {
+      const entry e = decode(slot, end);
+      if (e.remainder == remainder) {
+        const encoded_entry grown = encode(remainder, e.count + count);
+        replace_entry(quotient, start, end, slot, e.length, grown);
+        return {count, grown.length - e.length, false};
+      }
+      if (e.remainder > remainder) break;
+      slot += e.length;
+    }
+    const encoded_entry e = encode(remainder, count);
+    replace_entry(quotient, start, end, slot, 0, e);
+    return {count, e.length, true};
+  }
+  // Last slot that insert_fingerprint() with these arguments writes, or
+  // total_slots() if it would run out of slack slots. Counts only grow
+  // longer, so it takes as many empty slots after the run as its entry
+  // gains.
+  size_type insert_reach(size_type quotient, std::uint64_t remainder,
+                         std::uint64_t count) const noexcept {
+    size_type from, grow = encode(remainder, count).length;
+    if (!occupied(quotient)) {
+      from = std::max(quotient, run_end_next(quotient));
+    } else {
+      const size_type end = run_end_next(quotient) - 1;
+      for (size_type slot = run_start(quotient, end); slot <= end;) {
+        const entry e = decode(slot, end);
+        if (e.remainder == remainder)
+          grow = encode(remainder, e.count + count).length - e.length;
+        if (e.remainder >= remainder) break;
+        slot += e.length;
+      }
+      from = end + 1;
+    }
+    size_type last = from - 1;
+    for (; grow > 0; --grow) {
+      last = first_empty_slot(from);
+      if (last == total_slots()) break;
+      from = last + 1;
+    }
+    return last;
+  }
+
+  // Removes up to count copies of a fingerprint, leaving the counters
+  // alone. Shrinking an entry never needs free slots, so this does not
+  // throw.
+  change erase_fingerprint(size_type quotient, std::uint64_t remainder,
+                           std::uint64_t count) noexcept {
+    if (count == 0 || !occupied(quotient)) return {};
+    const size_type end = run_end_next(quotient) - 1;
+    const size_type start = run_start(quotient, end);
+    for (size_type slot = start; slot <= end;) {
+      const entry e = decode(slot, end);
+      if (e.remainder > remainder) break;
+      if (e.remainder < remainder) {
+        slot += e.length;
+        continue;
+      }
+      const std::uint64_t removed = std::min(count, e.count);
+      const encoded_entry shrunk = removed < e.count
+                                       ? encode(remainder, e.count - removed)
+                                       : encoded_entry{};
+      replace_entry(quotient, start, end, slot, e.length, shrunk);
+      return {removed, e.length - shrunk.length, removed == e.count};
+    }
+    return {};
   }
+  // Last slot that erase_fingerprint() of a quotient may write.
+  size_type erase_reach(size_type quotient) const noexcept {
+    if (!occupied(quotient)) return quotient;
+    return shifted_runs_end(quotient, run_end_next(quotient) - 1);
+  }
+
+  void insert_hash(std::uint64_t key_hash, std::uint64_t count) {
+    if (count == 0) return;
+    if (slots_used_ >= capacity())
+      throw std::length_error("quotient_filter: load factor exceeded");
+    const auto [quotient, remainder] = split(key_hash);
+    const change c = insert_fingerprint(quotient, remainder, count);
+    slots_used_ += c.slots;
+    num_fingerprints_ += c.fingerprint;
+    size_ += c.count;
+  }
+  std::uint64_t erase_hash(std::uint64_t key_hash,
+                           std::uint64_t count) noexcept {
+    const auto [quotient, remainder] = split(key_hash);
+    const change c = erase_fingerprint(quotient, remainder, count);
+    slots_used_ -= c.slots;
+    num_fingerprints_ -= c.fingerprint;
+    size_ -= c.count;
+    return c.count;
+  }
+
+  std::vector<std::uint64_t, word_allocator> words_;
+  size_type quotient_bits_;
+  size_type remainder_bits_;
+  size_type num_blocks_ = 0;
+  size_type size_ = 0;
+  size_type num_fingerprints_ = 0;
+  size_type slots_used_ = 0;
+  seed_type seed_;
+  double max_load_factor_ = default_max_load_factor;
 };
+
 }  // namespace pds
 #endif
@@ -0,0 +1,428 @@
+#ifndef PDS_RIBBON_FILTER_HPP
+#define PDS_RIBBON_FILTER_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <sul/dynamic_bitset.hpp>
+
+#include "hash.hpp"
+#include "simd.hpp"
+#include "xor_filter.hpp"
+
+// Homogeneous Ribbon filter (Dillinger and Walzer, "Ribbon filter: practically
+// smaller than Bloom and Xor"). Every key is a linear equation over GF(2):
+// a Width-bit coefficient row placed at a start slot must have a zero dot
+// product with the solution bits from that slot on, for each of the r result
+// columns. The equations form a band of width Width, so Gaussian elimination
+// runs on the fly as keys are added, and back substitution fills the slots no
+// key pinned down with pseudorandom bits. A key that was not added then
+// passes each column with probability 1/2, for a false positive rate of
+// about 2^-r. Homogeneous equations are always consistent, so construction
+// never fails and needs no retries; a few percent of extra slots keep the
+// rate close to 2^-r.
+//
+// The solution is stored interleaved: each block of Width slots holds one
+// Width-bit word per column, and the blocks in the upper part of the array
+// hold one column more than the lower ones. That makes bits per key
+// fractional: 1% takes about 7.2 bits per key with a 64-bit ribbon and 6.9
+// with a 128-bit one, against 9.6 for a Bloom filter, 9.8 for an 8-bit xor
+// filter and 6.64 for the information theoretic minimum. A lookup
+// reads the r words of its block and the r words after them, in the same or
+// the next cache line.
+
+namespace pds {
+
+namespace ribbon {
+
+// Whether any column j < columns has an odd dot product of c with the Width
+// solution bits starting shift bits into lo[j], continuing into hi[j].
+namespace scalar {
+inline bool any_odd(const std::uint64_t *lo, const std::uint64_t *hi,
+                    unsigned shift, std::uint64_t c,
+                    std::size_t columns) noexcept {
+  std::uint64_t odd = 0;
+  for (std::size_t j = 0; j < columns; ++j) {
+    const std::uint64_t bits = (lo[j] >> shift) | ((hi[j] << 1) << (63 - shift));
+    odd |= std::popcount(bits & c);
+  }
+  return odd & 1;
+}
+inline bool any_odd(const unsigned __int128 *lo, const unsigned __int128 *hi,
+                    unsigned shift, unsigned __int128 c,
+                    std::size_t columns) noexcept {
+  std::uint64_t odd = 0;
+  for (std::size_t j = 0; j < columns; ++j) {
+    const unsigned __int128 bits =
+        (lo[j] >> shift) | ((hi[j] << 1) << (127 - shift));
+    const unsigned __int128 x = bits & c;
+    odd |= std::popcount(static_cast<std::uint64_t>(x)) +
+           std::popcount(static_cast<std::uint64_t>(x >> 64));
+  }
+  return odd & 1;
+}
+}  // namespace scalar
+
+#if PDS_X86_DISPATCH
+// Four or eight columns per instruction. Shift counts of 64 clear a lane, so
+// a key starting on a block boundary needs no special case, and parities are
+// folded within each lane before the lanes are or-ed together.
+namespace avx2 {
+PDS_TARGET("avx2") inline __m256i parity(__m256i x) noexcept {
+  x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 32));
+  x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 16));
+  x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 8));
+  x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 4));
+  x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 2));
+  return _mm256_xor_si256(x, _mm256_srli_epi64(x, 1));
+}
+PDS_TARGET("avx2")
+inline bool any_odd(const std::uint64_t *lo, const std::uint64_t *hi,
+                    unsigned shift, std::uint64_t c,
+                    std::size_t columns) noexcept {
+  const __m128i right = _mm_cvtsi32_si128(static_cast<int>(shift));
+  const __m128i left = _mm_cvtsi32_si128(static_cast<int>(64 - shift));
+  const __m256i coeff = _mm256_set1_epi64x(static_cast<long long>(c));
+  __m256i odd = _mm256_setzero_si256();
+  std::size_t j = 0;
+  for (; j + 4 <= columns; j += 4) {
+    const __m256i bits = _mm256_or_si256(
+        _mm256_srl_epi64(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lo + j)),
+            right),
+        _mm256_sll_epi64(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(hi + j)),
+            left));
+    odd = _mm256_or_si256(odd, parity(_mm256_and_si256(bits, coeff)));
+  }
+  if (!_mm256_testz_si256(odd, _mm256_set1_epi64x(1))) return true;
+  return scalar::any_odd(lo + j, hi + j, shift, c, columns - j);
+}
+}  // namespace avx2
+
+namespace avx512 {
+PDS_TARGET("avx512f") inline __m512i parity(__m512i x) noexcept {
+  x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 32));
+  x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 16));
+  x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 8));
+  x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 4));
+  x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 2));
+  return _mm512_xor_si512(x, _mm512_srli_epi64(x, 1));
+}
+// The tail is a masked load, so up to eight columns take one pass.
+PDS_TARGET("avx512f")
+inline bool any_odd(const std::uint64_t *lo, const std::uint64_t *hi,
+                    unsigned shift, std::uint64_t c,
+                    std::size_t columns) noexcept {
+  const __m128i right = _mm_cvtsi32_si128(static_cast<int>(shift));
+  const __m128i left = _mm_cvtsi32_si128(static_cast<int>(64 - shift));
+  const __m512i coeff = _mm512_set1_epi64(static_cast<long long>(c));
+  __m512i odd = _mm512_setzero_si512();
+  for (std::size_t j = 0; j < columns; j += 8) {
+    const __mmask8 mask = columns - j >= 8
+                              ? __mmask8(0xff)
+                              : static_cast<__mmask8>((1u << (columns - j)) - 1);
+    const __m512i bits = _mm512_or_si512(
+        _mm512_srl_epi64(_mm512_maskz_loadu_epi64(mask, lo + j), right),
+        _mm512_sll_epi64(_mm512_maskz_loadu_epi64(mask, hi + j), left));
+    odd = _mm512_or_si512(odd, parity(_mm512_and_si512(bits, coeff)));
+  }
+  return _mm512_test_epi64_mask(odd, _mm512_set1_epi64(1)) != 0;
+}
+}  // namespace avx512
+#endif
+
+template <typename T>
+inline unsigned parity(T x) noexcept {
+  if constexpr (std::same_as<T, unsigned __int128>) {
+    return parity(static_cast<std::uint64_t>(x ^ (x >> 64)));
+  } else {
+    return static_cast<unsigned>(std::popcount(x)) & 1u;
+  }
+}
+
+template <typename T>
+inline int countr_zero(T x) noexcept {
+  if constexpr (std::same_as<T, unsigned __int128>) {
+    const auto low = static_cast<std::uint64_t>(x);
+    return low ? std::countr_zero(low)
+               : 64 + std::countr_zero(static_cast<std::uint64_t>(x >> 64));
+  } else {
+    return std::countr_zero(x);
+  }
+}
+
+}  // namespace ribbon
+
+template <typename Key, std::size_t Width = 64,
+          hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>,
+          typename Allocator = std::allocator<unsigned long>>
+class ribbon_filter
+    : public xor_detail::hashed_lookup<
+          ribbon_filter<Key, Width, Hash, Allocator>, Key, Hash> {
+  static_assert(Width == 64 || Width == 128);
+
+ public:
+  using key_type = Key;
+  using coeff_type =
+      std::conditional_t<Width == 64, std::uint64_t, unsigned __int128>;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using hash_function_type = Hash;
+
+  static_assert(std::numeric_limits<typename Hash::hash_type>::digits >= 64,
+                "ribbon filters need a 64-bit hash");
+
+  static constexpr size_type ribbon_width = Width;
+  // Extra slots per key. A wider ribbon needs fewer for the same penalty
+  // on the false positive rate.
+  static constexpr double default_overhead = Width == 64 ? 0.08 : 0.04;
+  // Number of keys hashed ahead of the probe in the batched operations.
+  static constexpr size_type batch_window = 16;
+
+  // Bits per key for the requested false positive probability.
+  static double bits_per_key_for(double false_positive_probability,
+                                 double overhead = default_overhead) {
+    return std::log2(1.0 / false_positive_probability) * (1.0 + overhead);
+  }
+
+ private:
+  using coeff_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<coeff_type>;
+
+ public:
+  // Builds the filter from the keys in [first, last) with bits_per_key bits
+  // of solution per key, of which a fraction overhead / (1 + overhead) pays
+  // for the extra slots. Duplicate keys are harmless.
+  template <std::forward_iterator It>
+  ribbon_filter(It first, It last, double bits_per_key,
+                double overhead = default_overhead,
+                const Allocator &alloc = Allocator())
+      : solution_(coeff_allocator(alloc)), isa_{simd::best_isa()} {
+    if (!(bits_per_key > 0) || !(overhead >= 0))
+      throw std::invalid_argument("ribbon_filter: bad bits per key");
+    const auto n = static_cast<size_type>(std::distance(first, last));
+    set_geometry(n, bits_per_key / (1.0 + overhead), overhead);
+
+    using hash_allocator = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<std::uint64_t>;
+    std::vector<std::uint64_t, hash_allocator> hashes(hash_allocator{alloc});
+    hashes.reserve(n);
+    for (auto it = first; it != last; ++it)
+      hashes.push_back(this->hash_key(*it));
+    build(hashes, alloc);
+    size_ = n;
+  }
+
+  bool contains_hash(std::uint64_t key_hash) const noexcept {
+    const size_type start = start_slot(key_hash);
+    const size_type block = start / Width;
+    const size_type columns = columns_of(block);
+    const coeff_type *lo = solution_.data() + offset_of(block);
+    const auto shift = static_cast<unsigned>(start % Width);
+    const coeff_type c = coefficients(key_hash);
+    if constexpr (Width == 64) {
+      switch (isa_) {
+#if PDS_X86_DISPATCH
+        case simd::isa::avx512:
+          return !ribbon::avx512::any_odd(lo, lo + columns, shift, c, columns);
+        case simd::isa::avx2:
+          return !ribbon::avx2::any_odd(lo, lo + columns, shift, c, columns);
+#endif
+        default:
+          break;
+      }
+    }
+    return !ribbon::scalar::any_odd(lo, lo + columns, shift, c, columns);
+  }
+
+  // Writes contains(keys[i]) to results[i] and returns the number of hits.
+  // Keys are hashed batch_window ahead and their solution words prefetched,
+  // so the cache misses of consecutive keys overlap.
+  std::size_t contains_batch(std::span<const Key> keys,
+                             std::span<bool> results) const noexcept {
+    assert(results.size() >= keys.size());
+    std::size_t hits = 0;
+    pipelined(keys, [&](size_type i, std::uint64_t hash) {
+      hits += results[i] = contains_hash(hash);
+    });
+    return hits;
+  }
+  template <typename Block, typename BlockAllocator>
+  std::size_t contains_batch(
+      std::span<const Key> keys,
+      sul::dynamic_bitset<Block, BlockAllocator> &results) const noexcept {
+    assert(results.size() >= keys.size());
+    std::size_t hits = 0;
+    pipelined(keys, [&](size_type i, std::uint64_t hash) {
+      const bool hit = contains_hash(hash);
+      results.set(i, hit);
+      hits += hit;
+    });
+    return hits;
+  }
+
+  // Returns the instruction set used by contains.
+  simd::isa isa() const noexcept { return isa_; }
+  // Forces a particular code path. Requests the host cannot run fall back to
+  // the scalar kernel.
+  void set_isa(simd::isa target) noexcept {
+    isa_ = simd::supports(target) ? target : simd::isa::scalar;
+  }
+
+  size_type size() const noexcept { return size_; }
+  size_type num_slots() const noexcept { return num_blocks_ * Width; }
+  size_type size_in_bytes() const noexcept {
+    return solution_.size() * sizeof(coeff_type);
+  }
+  double bits_per_key() const noexcept {
+    return size_ ? 8.0 * static_cast<double>(size_in_bytes()) /
+                       static_cast<double>(size_)
+                 : 0.0;
+  }
+  // Columns of the lower blocks; the upper ones have one more.
+  size_type lower_columns() const noexcept { return lower_columns_; }
+  double false_positive_probability() const noexcept {
+    const double upper =
+        static_cast<double>(num_blocks_ - upper_start_) / num_blocks_;
+    return std::ldexp(1.0 - upper / 2, -static_cast<int>(lower_columns_));
+  }
+
+ private:
+  void set_geometry(size_type n, double bits_per_slot, double overhead) {
+    num_blocks_ = std::max<size_type>(
+        2, static_cast<size_type>(std::ceil(static_cast<double>(n) *
+                                            (1.0 + overhead) / Width)));
+    lower_columns_ = static_cast<size_type>(bits_per_slot);
+    if (lower_columns_ >= 64)
+      throw std::invalid_argument("ribbon_filter: bad bits per key");
+    const auto upper_blocks = static_cast<size_type>(std::round(
+        (bits_per_slot - static_cast<double>(lower_columns_)) * num_blocks_));
+    upper_start_ = num_blocks_ - std::min(upper_blocks, num_blocks_);
+    // Zero padding after the last block, read by keys starting in it.
+    solution_.assign(offset_of(num_blocks_) + lower_columns_ + 1, 0);
+  }
+
+  size_type columns_of(size_type block) const noexcept {
+    return lower_columns_ + (block >= upper_start_);
+  }
+  size_type offset_of(size_type block) const noexcept {
+    return block * lower_columns_ +
+           (block > upper_start_ ? block - upper_start_ : 0);
+  }
+  // Starts leave room for a whole ribbon before the end of the array.
+  size_type start_slot(std::uint64_t key_hash) const noexcept {
+    return static_cast<size_type>(hash::fast_range<std::uint64_t>{}(
+        key_hash, num_blocks_ * Width - Width + 1));
+  }
+  // The first coefficient is always set, so an equation starts at its slot.
+  static coeff_type coefficients(std::uint64_t key_hash) noexcept {
+    const std::uint64_t c = xor_detail::mix(key_hash ^ 0x9e3779b97f4a7c15ULL);
+    if constexpr (Width == 64) {
+      return c | 1u;
+    } else {
+      return (coeff_type{xor_detail::mix(c)} << 64) | c | 1u;
+    }
+  }
+
+  template <typename HashVector>
+  void build(const HashVector &hashes, const Allocator &alloc) {
+    using rebind = std::allocator_traits<Allocator>;
+    using u64_allocator = typename rebind::template rebind_alloc<std::uint64_t>;
+    const size_type num_slots = num_blocks_ * Width;
+
+    // Bucket-sort the hashes by start block (the start grows with the hash),
+    // so that banding sweeps the rows front to back.
+    const int bucket_bits =
+        std::bit_width(std::max<size_type>(num_blocks_, 2) - 1);
+    std::vector<std::uint64_t, u64_allocator> bucket_start(
+        (size_type{1} << bucket_bits) + 1, u64_allocator{alloc});
+    for (auto h : hashes) ++bucket_start[(h >> (64 - bucket_bits)) + 1];
+    for (size_type b = 1; b < bucket_start.size(); ++b)
+      bucket_start[b] += bucket_start[b - 1];
+    std::vector<std::uint64_t, u64_allocator> order(hashes.size(),
+                                                    u64_allocator{alloc});
+    for (auto h : hashes) order[bucket_start[h >> (64 - bucket_bits)]++] = h;
+
+    // On-the-fly Gaussian elimination: rows[s] holds the equation with its
+    // leading coefficient at slot s, or zero. An equation that reduces to
+    // zero is implied by the others, which for homogeneous ones means it
+    // already holds.
+    std::vector<coeff_type, coeff_allocator> rows(num_slots,
+                                                  coeff_allocator(alloc));
+    for (auto h : order) {
+      size_type s = start_slot(h);
+      coeff_type c = coefficients(h);
+      while (true) {
+        coeff_type &row = rows[s];
+        if (row == 0) {
+          row = c;
+          break;
+        }
+        c ^= row;
+        if (c == 0) break;
+        const int skip = ribbon::countr_zero(c);
+        s += static_cast<size_type>(skip);
+        c >>= skip;
+      }
+    }
+
+    // Back substitution from the last slot down. window[j] holds the
+    // solution bits of column j from the current slot on, so at a block
+    // boundary it is that block's word.
+    coeff_type window[64] = {};
+    for (size_type i = num_slots; i-- > 0;) {
+      const size_type block = i / Width;
+      const size_type columns = columns_of(block);
+      const coeff_type row = rows[i];
+      const std::uint64_t free_bits = xor_detail::mix(i + 1);
+      for (size_type j = 0; j < columns; ++j) {
+        window[j] <<= 1;
+        window[j] |= row ? ribbon::parity(row & window[j])
+                         : static_cast<unsigned>(free_bits >> j) & 1u;
+      }
+      if (i % Width == 0) {
+        std::copy_n(window, columns, solution_.data() + offset_of(block));
+      }
+    }
+  }
+
+  // Hashes key i into a ring of batch_window slots and prefetches its
+  // solution words, then hands the hash of key i - batch_window to op.
+  template <typename Op>
+  void pipelined(std::span<const Key> keys, Op &&op) const {
+    std::uint64_t ring[batch_window];
+    const size_type n = keys.size();
+    for (size_type i = 0; i < n + batch_window; ++i) {
+      auto &slot = ring[i % batch_window];
+      if (i >= batch_window) op(i - batch_window, slot);
+      if (i >= n) continue;
+      slot = this->hash_key(keys[i]);
+      const size_type block = start_slot(slot) / Width;
+      const coeff_type *lo = solution_.data() + offset_of(block);
+      simd::prefetch_read(lo);
+      simd::prefetch_read(lo + 2 * columns_of(block) - 1);
+    }
+  }
+
+  std::vector<coeff_type, coeff_allocator> solution_;
+  size_type num_blocks_ = 0;
+  size_type lower_columns_ = 0;
+  size_type upper_start_ = 0;
+  size_type size_ = 0;
+  simd::isa isa_;
+};
+
+}  // namespace pds
+#endif
@@ -0,0 +1,231 @@
+#ifndef PDS_SCALABLE_BLOOM_FILTER_HPP
+#define PDS_SCALABLE_BLOOM_FILTER_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "blocked_bloom_filter.hpp"
+#include "bloom_filter.hpp"
+
+// Scalable Bloom filter (Almeida, Baquero, Preguica, Hutchison: "Scalable
+// Bloom Filters"). Keys go into the newest of a chain of stages; when it
+// reaches its capacity a new stage is added with growth times the capacity
+// and tightening times the false positive probability. The stage
+// probabilities form a geometric series, so the compound false positive
+// probability stays below the target however many keys are inserted.
+
+namespace pds {
+
+enum class growth_trigger {
+  // Count inserts into the newest stage. Cheap, but duplicates count too.
+  insert_count,
+  // When the count reaches capacity, re-estimate the number of distinct keys
+  // in the stage from its set bits and only grow if the estimate agrees.
+  estimated_cardinality,
+};
+
+struct scalable_options {
+  std::size_t initial_capacity = 1024;
+  double false_positive_probability = 0.03;
+  double growth = 2.0;
+  double tightening = 0.85;
+  growth_trigger trigger = growth_trigger::insert_count;
+  // Hash each looked up key once with the newest stage's generator and
+  // derive the positions of older stages from it, prefetching the words of
+  // all stages before probing any. Requires power-of-two sized stages and a
+  // generator whose j-th hash does not depend on k, e.g.
+  // simple_hash_generator or double_hash_generator, with a range function
+  // whose hash::range_bits_v is known: mod_range, fast_mod_range, fast_range
+  // or pow_2_range.
+  bool fused = false;
+};
+
+template <typename Key, typename Stage = blocked_bloom_filter<Key>>
+class scalable_bloom_filter {
+ public:
+  using key_type = Key;
+  using size_type = std::size_t;
+  using stage_type = Stage;
+
+  // Fused lookups fall back to probing stage by stage for larger k.
+  static constexpr size_type max_fused_hashes = 32;
+  // Whether older stage positions can be derived from the newest stage's.
+  static constexpr hash::range_bits fused_range_bits =
+      hash::generator_range_bits_v<typename Stage::hash_generator_type>;
+
+  explicit scalable_bloom_filter(const scalable_options &options)
+      : options_(options) {
+    assert(options_.initial_capacity > 0);
+    assert(options_.growth >= 1.0);
+    assert(options_.tightening > 0.0 && options_.tightening < 1.0);
+    check_fusable(options_.fused);
+    add_stage();
+  }
+  scalable_bloom_filter(std::size_t initial_capacity,
+                        double false_positive_probability = 0.03)
+      : scalable_bloom_filter(scalable_options{
+            .initial_capacity = initial_capacity,
+            .false_positive_probability = false_positive_probability}) {}
+
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) {
+    for (auto it = first; it != last; ++it) {
+      insert(*it);
+    }
+  }
+  void insert(const Key &key) {
+    if (newest_count_ >= stage_capacity(stages_.size() - 1)) grow();
+    stages_.back().insert(key);
+    ++newest_count_;
+    ++size_;
+  }
+  // Probes the newest stage first: recently inserted keys are the most
+  // likely to be looked up, and it holds the most keys.
+  bool contains(const Key &key) const noexcept {
+    if constexpr (fused_range_bits != hash::range_bits::unknown) {
+      if (options_.fused && stages_.size() > 1 &&
+          stages_.back().hashes_per_key() <= max_fused_hashes)
+        return contains_fused(key);
+    }
+    return std::ranges::any_of(stages_ | std::views::reverse,
+                               [&](const Stage &s) { return s.contains(key); });
+  }
+
+  void clear() {
+    stages_.erase(stages_.begin() + 1, stages_.end());
+    stages_.front().clear();
+    newest_count_ = 0;
+    size_ = 0;
+  }
+
+  bool fused() const noexcept { return options_.fused; }
+  void set_fused(bool fused) {
+    check_fusable(fused);
+    options_.fused = fused;
+  }
+
+  // Returns the number of inserts, duplicates included.
+  std::size_t size() const noexcept { return size_; }
+  std::size_t num_stages() const noexcept { return stages_.size(); }
+  const Stage &stage(std::size_t i) const noexcept { return stages_[i]; }
+
+  // Returns the number of keys stage i is sized for.
+  std::size_t stage_capacity(std::size_t i) const noexcept {
+    return static_cast<std::size_t>(
+        std::ceil(static_cast<double>(options_.initial_capacity) *
+                  std::pow(options_.growth, static_cast<double>(i))));
+  }
+  // Returns the false positive probability stage i is sized for. The series
+  // sums to the target probability.
+  double stage_false_positive_probability(std::size_t i) const noexcept {
+    return options_.false_positive_probability * (1.0 - options_.tightening) *
+           std::pow(options_.tightening, static_cast<double>(i));
+  }
+
+  // Returns the number of bits over all stages.
+  std::size_t bit_capacity() const noexcept {
+    std::size_t bits = 0;
+    for (const auto &s : stages_) bits += s.bit_capacity();
+    return bits;
+  }
+
+  std::size_t num_set_bits() const noexcept {
+    std::size_t bits = 0;
+    for (const auto &s : stages_) bits += s.num_set_bits();
+    return bits;
+  }
+
+  std::size_t approximate_cardinality() const noexcept {
+    std::size_t n = 0;
+    for (const auto &s : stages_) n += s.approximate_cardinality();
+    return n;
+  }
+
+  // A key is a false positive if any stage reports it.
+  double approximate_fpp() const noexcept {
+    double miss = 1.0;
+    for (const auto &s : stages_) miss *= 1.0 - s.approximate_fpp();
+    return 1.0 - miss;
+  }
+
+ private:
+  static void check_fusable(bool fused) {
+    if (fused && fused_range_bits == hash::range_bits::unknown)
+      throw std::invalid_argument(
+          "scalable_bloom_filter: fused lookups need a range function with "
+          "known range_bits");
+  }
+
+  void add_stage() {
+    const auto i = stages_.size();
+    stages_.emplace_back(stage_capacity(i),
+                         stage_false_positive_probability(i));
+    // Fused lookups derive older positions from the newest stage's hashes.
+    assert(!options_.fused ||
+           (std::has_single_bit(stages_.back().bit_capacity()) &&
+            (i == 0 || stages_[i - 1].hashes_per_key() <=
+                           stages_.back().hashes_per_key())));
+    newest_count_ = 0;
+  }
+
+  void grow() {
+    if (options_.trigger == growth_trigger::estimated_cardinality) {
+      const auto estimate = stages_.back().approximate_cardinality();
+      if (estimate < stage_capacity(stages_.size() - 1)) {
+        newest_count_ = estimate;
+        return;
+      }
+    }
+    add_stage();
+  }
+
+  bool contains_fused(const Key &key) const noexcept
+    requires(fused_range_bits != hash::range_bits::unknown)
+  {
+    const auto generator = stages_.back().hash_generator();
+    size_type positions[max_fused_hashes];
+    size_type derived[max_fused_hashes];
+    size_type k = 0;
+    for (auto hash : generator.hashes(key)) {
+      positions[k++] = hash;
+    }
+    // The positions in a stage of 2^b bits are the low b bits of those in
+    // the newest stage of 2^B bits, or the high b of its B bits for range
+    // functions that keep the high bits of the hash. Its k is a prefix of the
+    // newest stage's.
+    const int newest_bits = std::countr_zero(stages_.back().bit_capacity());
+    auto derive = [&](const Stage &s) {
+      const size_type n = s.hashes_per_key();
+      if constexpr (fused_range_bits == hash::range_bits::low) {
+        const size_type mask = s.bit_capacity() - 1;
+        for (size_type j = 0; j < n; ++j) derived[j] = positions[j] & mask;
+      } else {
+        const int shift = newest_bits - std::countr_zero(s.bit_capacity());
+        for (size_type j = 0; j < n; ++j) derived[j] = positions[j] >> shift;
+      }
+      return std::span<const size_type>(derived, n);
+    };
+    for (const auto &s : stages_ | std::views::reverse) {
+      s.prefetch_positions(derive(s));
+    }
+    for (const auto &s : stages_ | std::views::reverse) {
+      if (s.contains_positions(derive(s))) return true;
+    }
+    return false;
+  }
+
+  scalable_options options_;
+  std::vector<Stage> stages_;
+  std::size_t newest_count_ = 0;
+  std::size_t size_ = 0;
+};
+
+}  // namespace pds
+#endif
@@ -0,0 +1,260 @@
+#ifndef PDS_SERIALIZATION_HPP
+#define PDS_SERIALIZATION_HPP
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "bloom_filter.hpp"
+#include "crc32c.hpp"
+#include "hash.hpp"
+
+// On-disk format of a bloom_filter, version 1:
+//
+//   offset 0                 header (64 bytes, below)
+//   offset payload_offset    bit array, payload_bytes long, laid out like
+//                            bloom_filter::data(); payload_offset is a
+//                            multiple of 64 so the words can be mapped in place
+//   payload_offset + bytes   CRC-32C of everything before it (4 bytes)
+//
+// All integers are in host byte order; byte_order lets a reader detect a file
+// written on a host with the other endianness.
+
+namespace pds {
+namespace serialization {
+
+inline constexpr char magic[8] = {'P', 'D', 'S', 'B', 'L', 'O', 'O', 'M'};
+inline constexpr std::uint32_t format_version = 1;
+inline constexpr std::uint32_t byte_order_mark = 0x01020304u;
+inline constexpr std::size_t payload_alignment = 64;
+
+struct header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t payload_offset;
+  std::uint64_t num_bits;
+  std::uint64_t num_hashes;
+  std::uint64_t payload_bytes;
+  std::uint32_t generator_id;
+  std::uint32_t seed;
+  std::uint32_t word_bits;
+  std::uint32_t byte_order;
+  std::uint8_t reserved[8];
+};
+static_assert(sizeof(header) == 64);
+
+inline constexpr std::uint32_t payload_offset =
+    (sizeof(header) + payload_alignment - 1) / payload_alignment *
+    payload_alignment;
+
+class format_error : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+// Identifies what a hash generator computes, so a filter is never loaded with
+// a generator that would probe different bits. The id packs the generator
+// family, the underlying hash function and the range reduction. There is no
+// default: a user hash or range function must specialise these with its own
+// nonzero id before filters using it can be saved.
+template <typename T>
+struct hash_function_id;
+template <typename Key>
+struct hash_function_id<hash::murmer3_x86_32<Key>>
+    : std::integral_constant<std::uint32_t, 1> {};
+template <typename Key>
+struct hash_function_id<hash::murmer3_x64_128<Key>>
+    : std::integral_constant<std::uint32_t, 2> {};
+
+template <typename T>
+struct range_function_id;
+template <typename T>
+struct range_function_id<hash::mod_range<T>>
+    : std::integral_constant<std::uint32_t, 1> {};
+template <typename T>
+struct range_function_id<hash::pow_2_range<T>>
+    : std::integral_constant<std::uint32_t, 2> {};
+template <typename T>
+struct range_function_id<hash::fast_range<T>>
+    : std::integral_constant<std::uint32_t, 3> {};
+// Same values as mod_range, so files are interchangeable.
+template <typename T>
+struct range_function_id<hash::fast_mod_range<T>>
+    : std::integral_constant<std::uint32_t, 1> {};
+
+constexpr std::uint32_t make_generator_id(std::uint32_t family,
+                                          std::uint32_t hash,
+                                          std::uint32_t range) {
+  return family << 16 | hash << 8 | range;
+}
+
+// Specialised for every generator that can be saved: its id, its seed and
+// how to rebuild it from the header.
+template <typename HashGen>
+struct generator_traits;
+
+template <typename T>
+concept HasFunctionId = requires { T::value; } && T::value != 0;
+
+template <typename Key, typename Hash, typename Range>
+  requires HasFunctionId<hash_function_id<Hash>> &&
+           HasFunctionId<range_function_id<Range>>
+struct generator_traits<hash::simple_hash_generator<Key, Hash, Range>> {
+  using generator_type = hash::simple_hash_generator<Key, Hash, Range>;
+  static constexpr std::uint32_t id =
+      make_generator_id(1, hash_function_id<Hash>::value,
+                        range_function_id<Range>::value);
+  static std::uint32_t seed(const generator_type &) { return 0; }
+  static generator_type make(std::size_t num_hashes, std::size_t range,
+                             std::uint32_t) {
+    return generator_type(num_hashes, range);
+  }
+};
+
+template <typename Key, typename Range, typename Probe>
+  requires HasFunctionId<range_function_id<Range>> &&
+           (std::same_as<Probe, hash::double_hashing> ||
+            std::same_as<Probe, hash::enhanced_double_hashing>)
+struct generator_traits<hash::double_hash_generator<Key, Range, Probe>> {
+  using generator_type = hash::double_hash_generator<Key, Range, Probe>;
+  static constexpr std::uint32_t id = make_generator_id(
+      std::same_as<Probe, hash::enhanced_double_hashing> ? 3 : 2,
+      hash_function_id<hash::murmer3_x64_128<Key>>::value,
+      range_function_id<Range>::value);
+  static std::uint32_t seed(const generator_type &g) { return g.seed(); }
+  static generator_type make(std::size_t num_hashes, std::size_t range,
+                             std::uint32_t seed) {
+    return generator_type(num_hashes, range, seed);
+  }
+};
+
+template <typename HashGen>
+concept SerializableGenerator = requires(const HashGen &g) {
+  { generator_traits<HashGen>::id } -> std::convertible_to<std::uint32_t>;
+  { generator_traits<HashGen>::seed(g) } -> std::convertible_to<std::uint32_t>;
+};
+
+template <typename HashGen, typename WordType>
+header make_header(const HashGen &generator) {
+  header h{};
+  std::memcpy(h.magic, magic, sizeof(magic));
+  h.version = format_version;
+  h.payload_offset = payload_offset;
+  h.num_bits = generator.range();
+  h.num_hashes = generator.hashes_per_key();
+  constexpr std::size_t word_bits = std::numeric_limits<WordType>::digits;
+  h.payload_bytes = (h.num_bits + word_bits - 1) / word_bits * sizeof(WordType);
+  h.generator_id = generator_traits<HashGen>::id;
+  h.seed = generator_traits<HashGen>::seed(generator);
+  h.word_bits = word_bits;
+  h.byte_order = byte_order_mark;
+  return h;
+}
+
+// Throws format_error unless h describes a filter of HashGen over WordType.
+template <typename HashGen, typename WordType>
+void validate(const header &h) {
+  if (std::memcmp(h.magic, magic, sizeof(magic)) != 0)
+    throw format_error("not a pds bloom filter");
+  if (h.byte_order != byte_order_mark)
+    throw format_error("bloom filter written with a different byte order");
+  if (h.version != format_version)
+    throw format_error("unsupported bloom filter format version");
+  if (h.word_bits != std::numeric_limits<WordType>::digits)
+    throw format_error("bloom filter word size mismatch");
+  if (h.generator_id != generator_traits<HashGen>::id)
+    throw format_error("bloom filter hash generator mismatch");
+  if (h.num_bits == 0 || h.num_hashes == 0)
+    throw format_error("empty bloom filter parameters");
+  if (h.payload_offset < sizeof(header) ||
+      h.payload_offset % payload_alignment != 0)
+    throw format_error("bad bloom filter payload offset");
+  constexpr std::size_t word_bits = std::numeric_limits<WordType>::digits;
+  if (h.payload_bytes !=
+      (h.num_bits + word_bits - 1) / word_bits * sizeof(WordType))
+    throw format_error("bloom filter payload size mismatch");
+}
+
+// Bytes hashed and copied per step when streaming, small enough to stay in
+// L2 between the checksum and the copy.
+inline constexpr std::size_t chunk_bytes = std::size_t{1} << 18;
+
+template <typename Key, typename HashGen, typename Allocator,
+          typename SizingPolicy, bool TrackSetBits>
+  requires SerializableGenerator<HashGen>
+void save(std::ostream &os,
+          const bloom_filter<Key, HashGen, Allocator, SizingPolicy,
+                             TrackSetBits> &bf) {
+  using word_type = typename bloom_filter<Key, HashGen, Allocator,
+                                          SizingPolicy, TrackSetBits>::word_type;
+  const header h = make_header<HashGen, word_type>(bf.hash_generator());
+  char head[payload_offset] = {};
+  std::memcpy(head, &h, sizeof(h));
+  std::uint32_t crc = crc32c(head, sizeof(head));
+  os.write(head, sizeof(head));
+  const auto *payload = reinterpret_cast<const char *>(bf.data().data());
+  for (std::size_t done = 0; done < h.payload_bytes;) {
+    const auto n = std::min<std::size_t>(chunk_bytes, h.payload_bytes - done);
+    crc = crc32c(payload + done, n, crc);
+    os.write(payload + done, static_cast<std::streamsize>(n));
+    done += n;
+  }
+  os.write(reinterpret_cast<const char *>(&crc), sizeof(crc));
+  if (!os) throw format_error("failed to write bloom filter");
+}
+
+// Reads a filter written by save straight into the storage of the result and
+// checks its checksum chunk by chunk while the data is still in cache.
+template <typename BloomFilter>
+  requires SerializableGenerator<typename BloomFilter::hash_generator_type>
+BloomFilter load(std::istream &is, const typename BloomFilter::allocator_type
+                                       &alloc = {}) {
+  using generator_type = typename BloomFilter::hash_generator_type;
+  using word_type = typename BloomFilter::word_type;
+  char head[payload_offset];
+  if (!is.read(head, sizeof(header)))
+    throw format_error("truncated bloom filter header");
+  header h;
+  std::memcpy(&h, head, sizeof(h));
+  validate<generator_type, word_type>(h);
+  std::uint32_t crc = crc32c(head, sizeof(header));
+  // Skip and checksum the padding up to the payload.
+  for (std::size_t skipped = sizeof(header); skipped < h.payload_offset;) {
+    const auto n = std::min<std::size_t>(sizeof(head),
+                                         h.payload_offset - skipped);
+    if (!is.read(head, static_cast<std::streamsize>(n)))
+      throw format_error("truncated bloom filter header");
+    crc = crc32c(head, n, crc);
+    skipped += n;
+  }
+  std::vector<word_type, typename BloomFilter::allocator_type> words(
+      h.payload_bytes / sizeof(word_type), 0, alloc);
+  auto *payload = reinterpret_cast<char *>(words.data());
+  for (std::size_t done = 0; done < h.payload_bytes;) {
+    const auto n = std::min<std::size_t>(chunk_bytes, h.payload_bytes - done);
+    if (!is.read(payload + done, static_cast<std::streamsize>(n)))
+      throw format_error("truncated bloom filter payload");
+    crc = crc32c(payload + done, n, crc);
+    done += n;
+  }
+  std::uint32_t stored;
+  if (!is.read(reinterpret_cast<char *>(&stored), sizeof(stored)))
+    throw format_error("missing bloom filter checksum");
+  if (stored != crc) throw format_error("bloom filter checksum mismatch");
+  return BloomFilter(generator_traits<generator_type>::make(
+                         h.num_hashes, h.num_bits, h.seed),
+                     std::move(words));
+}
+
+}  // namespace serialization
+}  // namespace pds
+#endif
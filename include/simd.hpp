@@ -0,0 +1,66 @@
+#ifndef PDS_SIMD_HPP
+#define PDS_SIMD_HPP
+
+// Runtime instruction set detection. Kernels that use wider instructions are
+// compiled with per-function target attributes, so the library itself does not
+// need to be built with -mavx2 and the same binary runs on every x86-64 host.
+
+#if (defined(__x86_64__) || defined(_M_X64)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define PDS_X86_DISPATCH 1
+#include <immintrin.h>
+#define PDS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PDS_X86_DISPATCH 0
+#define PDS_TARGET(isa)
+#endif
+
+namespace pds {
+namespace simd {
+
+enum class isa { scalar, avx2, avx512 };
+
+inline bool supports(isa target) noexcept {
+#if PDS_X86_DISPATCH
+  switch (target) {
+    case isa::avx512:
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512vl");
+    case isa::avx2:
+      return __builtin_cpu_supports("avx2");
+    case isa::scalar:
+      return true;
+  }
+  return false;
+#else
+  return target == isa::scalar;
+#endif
+}
+
+// Returns the widest instruction set the host supports.
+inline isa best_isa() noexcept {
+  static const isa best = supports(isa::avx512) ? isa::avx512
+                          : supports(isa::avx2) ? isa::avx2
+                                                : isa::scalar;
+  return best;
+}
+
+// Software prefetch hints. No-ops on compilers without the builtin.
+inline void prefetch_read(const void *address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address, 0, 3);
+#else
+  (void)address;
+#endif
+}
+inline void prefetch_write(const void *address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address, 1, 3);
+#else
+  (void)address;
+#endif
+}
+
+}  // namespace simd
+}  // namespace pds
+#endif
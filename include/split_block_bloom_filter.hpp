@@ -0,0 +1,331 @@
+#ifndef PDS_SPLIT_BLOCK_BLOOM_FILTER_HPP
+#define PDS_SPLIT_BLOCK_BLOOM_FILTER_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <sul/dynamic_bitset.hpp>
+
+#include "bit_kernels.hpp"
+#include "hash.hpp"
+#include "simd.hpp"
+
+// Split block Bloom filter as used by Impala, Kudu and Parquet. A 64-bit hash
+// picks a 256-bit block with its upper half and derives eight bit positions,
+// one per 32-bit lane, from its lower half by multiplying with fixed odd
+// salts. Every path below produces the same bits, so the layout only depends
+// on the hash function and can be shared between hosts with different ISAs.
+
+namespace pds {
+
+namespace split_block {
+
+inline constexpr std::size_t lanes = 8;
+
+struct alignas(32) block_type {
+  std::uint32_t lanes[8];
+};
+
+inline constexpr std::uint32_t salt[lanes] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+namespace scalar {
+inline std::uint32_t lane_mask(std::uint32_t key, std::size_t lane) noexcept {
+  return std::uint32_t{1} << ((key * salt[lane]) >> 27);
+}
+inline void insert(block_type &block, std::uint32_t key) noexcept {
+  for (std::size_t i = 0; i < lanes; ++i) block.lanes[i] |= lane_mask(key, i);
+}
+inline bool contains(const block_type &block, std::uint32_t key) noexcept {
+  for (std::size_t i = 0; i < lanes; ++i) {
+    if (!(block.lanes[i] & lane_mask(key, i))) return false;
+  }
+  return true;
+}
+}  // namespace scalar
+
+#if PDS_X86_DISPATCH
+namespace avx2 {
+PDS_TARGET("avx2") inline __m256i make_mask(std::uint32_t key) noexcept {
+  const __m256i salts =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(salt));
+  const __m256i shifts = _mm256_srli_epi32(
+      _mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(key)), salts), 27);
+  return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+}
+PDS_TARGET("avx2")
+inline void insert(block_type &block, std::uint32_t key) noexcept {
+  auto *p = reinterpret_cast<__m256i *>(block.lanes);
+  _mm256_store_si256(p, _mm256_or_si256(_mm256_load_si256(p), make_mask(key)));
+}
+PDS_TARGET("avx2")
+inline bool contains(const block_type &block, std::uint32_t key) noexcept {
+  const auto *p = reinterpret_cast<const __m256i *>(block.lanes);
+  return _mm256_testc_si256(_mm256_load_si256(p), make_mask(key));
+}
+}  // namespace avx2
+
+namespace avx512 {
+// With AVX-512VL the shift is a variable rotate of the broadcast one and the
+// membership test lands in a mask register instead of going through flags.
+PDS_TARGET("avx512f,avx512vl")
+inline __m256i make_mask(std::uint32_t key) noexcept {
+  const __m256i salts =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(salt));
+  const __m256i shifts = _mm256_srli_epi32(
+      _mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(key)), salts), 27);
+  return _mm256_rolv_epi32(_mm256_set1_epi32(1), shifts);
+}
+PDS_TARGET("avx512f,avx512vl")
+inline void insert(block_type &block, std::uint32_t key) noexcept {
+  auto *p = reinterpret_cast<__m256i *>(block.lanes);
+  _mm256_store_si256(p, _mm256_or_si256(_mm256_load_si256(p), make_mask(key)));
+}
+PDS_TARGET("avx512f,avx512vl")
+inline bool contains(const block_type &block, std::uint32_t key) noexcept {
+  const auto *p = reinterpret_cast<const __m256i *>(block.lanes);
+  const __m256i mask = make_mask(key);
+  return _mm256_cmpeq_epi32_mask(
+             _mm256_and_si256(_mm256_load_si256(p), mask), mask) == 0xff;
+}
+}  // namespace avx512
+#endif
+
+}  // namespace split_block
+
+template <typename Key,
+          hash::HashFunction<Key> Hash = pds::hash::murmer3_x64_128<Key>,
+          typename Allocator = std::allocator<unsigned long>>
+class split_block_bloom_filter {
+ public:
+  using key_type = Key;
+  using hash_type = typename Hash::hash_type;
+  using seed_type = typename Hash::seed_type;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using hash_function_type = Hash;
+  using block_type = split_block::block_type;
+
+  static_assert(std::numeric_limits<hash_type>::digits >= 64,
+                "split block filters need a 64-bit hash");
+
+  static constexpr size_type block_bits = 256;
+  static constexpr size_type hashes_per_key = split_block::lanes;
+  // Number of keys hashed ahead of the probe in the batched operations.
+  static constexpr size_type batch_window = 16;
+
+  // Number of bits needed for the requested false positive probability
+  // (formula from the Parquet specification).
+  static std::size_t optimal_num_bits(std::size_t input_size,
+                                      double false_positive_probability) {
+    const double bits =
+        -8.0 * static_cast<double>(input_size) /
+        std::log(1.0 - std::pow(false_positive_probability, 1.0 / 8.0));
+    return static_cast<std::size_t>(bits);
+  }
+
+ private:
+  using block_allocator_type = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<block_type>;
+
+  static size_type blocks_for(size_type num_bits) {
+    return std::max<size_type>((num_bits + block_bits - 1) / block_bits, 1);
+  }
+
+ public:
+  split_block_bloom_filter(std::size_t num_bits, seed_type seed,
+                           const Allocator &alloc = Allocator())
+      : blocks_(blocks_for(num_bits), block_type{},
+                block_allocator_type(alloc)),
+        seed_{seed},
+        isa_{simd::best_isa()} {
+    assert(blocks_.size() <= std::numeric_limits<std::uint32_t>::max());
+  }
+  split_block_bloom_filter(std::size_t input_size,
+                           double false_positive_probability = 0.03,
+                           const Allocator &alloc = Allocator())
+      : split_block_bloom_filter(
+            optimal_num_bits(input_size, false_positive_probability),
+            seed_type{0}, alloc) {}
+
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) noexcept {
+    for (auto it = first; it != last; ++it) {
+      insert(*it);
+    }
+  }
+  void insert(const Key &key) noexcept {
+    insert_hash(static_cast<std::uint64_t>(Hash{}(key, seed_)));
+  }
+  bool contains(const Key &key) const noexcept {
+    return contains_hash(static_cast<std::uint64_t>(Hash{}(key, seed_)));
+  }
+  template <hash::TransparentKey<Key> K>
+    requires std::invocable<Hash, const K &, seed_type>
+  bool contains(const K &key) const noexcept {
+    return contains_hash(static_cast<std::uint64_t>(Hash{}(key, seed_)));
+  }
+
+  // Batched operations hash batch_window keys ahead and prefetch their
+  // blocks, so the cache misses of consecutive keys overlap.
+  void insert_batch(std::span<const Key> keys) noexcept {
+    pipelined(keys, true,
+              [&](size_type, std::uint64_t hash) { insert_hash(hash); });
+  }
+  // Writes contains(keys[i]) to results[i] and returns the number of hits.
+  std::size_t contains_batch(std::span<const Key> keys,
+                             std::span<bool> results) const noexcept {
+    assert(results.size() >= keys.size());
+    std::size_t hits = 0;
+    pipelined(keys, false, [&](size_type i, std::uint64_t hash) {
+      hits += results[i] = contains_hash(hash);
+    });
+    return hits;
+  }
+  template <typename Block, typename BlockAllocator>
+  std::size_t contains_batch(
+      std::span<const Key> keys,
+      sul::dynamic_bitset<Block, BlockAllocator> &results) const noexcept {
+    assert(results.size() >= keys.size());
+    std::size_t hits = 0;
+    pipelined(keys, false, [&](size_type i, std::uint64_t hash) {
+      const bool hit = contains_hash(hash);
+      results.set(i, hit);
+      hits += hit;
+    });
+    return hits;
+  }
+
+  void clear() noexcept {
+    std::fill(blocks_.begin(), blocks_.end(), block_type{});
+  }
+
+  // Returns the instruction set used by insert and contains.
+  simd::isa isa() const noexcept { return isa_; }
+  // Forces a particular code path. Requests the host cannot run fall back to
+  // the scalar kernels.
+  void set_isa(simd::isa target) noexcept {
+    isa_ = simd::supports(target) ? target : simd::isa::scalar;
+  }
+
+  // Returns the number of bits.
+  std::size_t bit_capacity() const noexcept {
+    return blocks_.size() * block_bits;
+  }
+  std::size_t num_blocks() const noexcept { return blocks_.size(); }
+
+  // Returns the number of set bits in the underlying bit array.
+  std::size_t num_set_bits() const noexcept {
+    return simd::popcount_bytes(blocks_.data(),
+                                blocks_.size() * sizeof(block_type));
+  }
+
+  seed_type seed() const noexcept { return seed_; }
+
+  bool empty() const noexcept {
+    return std::all_of(blocks_.begin(), blocks_.end(),
+                       [](const block_type &block) {
+                         return std::ranges::all_of(
+                             block.lanes,
+                             [](std::uint32_t x) { return x == 0; });
+                       });
+  }
+
+  void swap(split_block_bloom_filter &other) noexcept {
+    blocks_.swap(other.blocks_);
+    std::swap(seed_, other.seed_);
+    std::swap(isa_, other.isa_);
+  }
+
+  std::span<const block_type> data() const noexcept { return blocks_; }
+
+  split_block_bloom_filter &operator&=(const split_block_bloom_filter &other) {
+    assert(other.num_blocks() == num_blocks() && other.seed_ == seed_);
+    for (std::size_t i = 0; i < blocks_.size(); ++i) {
+      for (std::size_t l = 0; l < split_block::lanes; ++l) {
+        blocks_[i].lanes[l] &= other.blocks_[i].lanes[l];
+      }
+    }
+    return *this;
+  }
+
+  split_block_bloom_filter &operator|=(const split_block_bloom_filter &other) {
+    assert(other.num_blocks() == num_blocks() && other.seed_ == seed_);
+    for (std::size_t i = 0; i < blocks_.size(); ++i) {
+      for (std::size_t l = 0; l < split_block::lanes; ++l) {
+        blocks_[i].lanes[l] |= other.blocks_[i].lanes[l];
+      }
+    }
+    return *this;
+  }
+
+ private:
+  void insert_hash(std::uint64_t hash) noexcept {
+    auto &block = blocks_[block_index(hash)];
+    const auto lane_key = static_cast<std::uint32_t>(hash);
+    switch (isa_) {
+#if PDS_X86_DISPATCH
+      case simd::isa::avx512:
+        return split_block::avx512::insert(block, lane_key);
+      case simd::isa::avx2:
+        return split_block::avx2::insert(block, lane_key);
+#endif
+      default:
+        return split_block::scalar::insert(block, lane_key);
+    }
+  }
+  bool contains_hash(std::uint64_t hash) const noexcept {
+    const auto &block = blocks_[block_index(hash)];
+    const auto lane_key = static_cast<std::uint32_t>(hash);
+    switch (isa_) {
+#if PDS_X86_DISPATCH
+      case simd::isa::avx512:
+        return split_block::avx512::contains(block, lane_key);
+      case simd::isa::avx2:
+        return split_block::avx2::contains(block, lane_key);
+#endif
+      default:
+        return split_block::scalar::contains(block, lane_key);
+    }
+  }
+
+  // Hashes key i into a ring of batch_window slots and prefetches its block,
+  // then hands the hash of key i - batch_window to op.
+  template <typename Op>
+  void pipelined(std::span<const Key> keys, bool for_write, Op &&op) const {
+    std::uint64_t ring[batch_window];
+    const size_type n = keys.size();
+    for (size_type i = 0; i < n + batch_window; ++i) {
+      auto &slot = ring[i % batch_window];
+      if (i >= batch_window) op(i - batch_window, slot);
+      if (i >= n) continue;
+      slot = static_cast<std::uint64_t>(Hash{}(keys[i], seed_));
+      const auto *block = &blocks_[block_index(slot)];
+      if (for_write)
+        simd::prefetch_write(block);
+      else
+        simd::prefetch_read(block);
+    }
+  }
+
+  size_type block_index(std::uint64_t hash) const noexcept {
+    return hash::fast_range<std::uint32_t>{}(
+        static_cast<std::uint32_t>(hash >> 32),
+        static_cast<std::uint32_t>(blocks_.size()));
+  }
+
+  std::vector<block_type, block_allocator_type> blocks_;
+  seed_type seed_;
+  simd::isa isa_;
+};
+
+}  // namespace pds
+#endif
@@ -0,0 +1,150 @@
+#ifndef PDS_STATIC_BLOOM_FILTER_HPP
+#define PDS_STATIC_BLOOM_FILTER_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include "bit_kernels.hpp"
+#include "bloom_filter.hpp"
+#include "hash.hpp"
+
+// Bloom filter whose geometry is fixed at compile time: Bits bits in an inline
+// std::array and K hashes. The probe loop is unrolled, and reducing a position
+// modulo the constant Bits compiles to a mask (power of two) or a
+// multiply-shift instead of a division. Meant for the many small filters of
+// known size, e.g. per connection or per request, which also avoid a heap
+// allocation this way.
+//
+// Positions follow a Kirsch-Mitzenmacher double hashing sequence whose two
+// halves come from one call of a 64-bit Hash (two calls of a 32-bit one).
+
+namespace pds {
+
+template <typename Key, std::size_t Bits, std::size_t K,
+          hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>>
+class static_bloom_filter {
+  static_assert(Bits > 0 && K > 0);
+  static_assert(Bits <= std::numeric_limits<std::uint32_t>::max(),
+                "positions are derived from 32-bit halves of the hash");
+
+ public:
+  using word_type = unsigned long;
+  using key_type = Key;
+  using size_type = std::size_t;
+  using hash_function_type = Hash;
+
+  static constexpr size_type bits_per_word =
+      std::numeric_limits<word_type>::digits;
+  static constexpr size_type bits_per_word_log2 =
+      std::countr_zero(bits_per_word);
+  static constexpr size_type word_mask = bits_per_word - 1u;
+  static constexpr size_type num_words =
+      (Bits + bits_per_word - 1) / bits_per_word;
+
+  static constexpr std::size_t bit_capacity() noexcept { return Bits; }
+  static constexpr std::size_t hashes_per_key() noexcept { return K; }
+
+  constexpr static_bloom_filter() noexcept = default;
+
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) noexcept {
+    for (auto it = first; it != last; ++it) {
+      insert(*it);
+    }
+  }
+  void insert(const Key &key) noexcept {
+    const auto [h1, h2] = split(key);
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      ((words_[position<I>(h1, h2) >> bits_per_word_log2] |=
+        word_type{1} << (position<I>(h1, h2) & word_mask)),
+       ...);
+    }(std::make_index_sequence<K>{});
+  }
+  bool contains(const Key &key) const noexcept { return test(split(key)); }
+  template <hash::TransparentKey<Key> T>
+    requires std::invocable<Hash, const T &, typename Hash::seed_type>
+  bool contains(const T &key) const noexcept {
+    return test(split(key));
+  }
+
+  void clear() noexcept { words_.fill(0); }
+
+  bool empty() const noexcept {
+    return std::ranges::all_of(words_, [](word_type x) { return x == 0; });
+  }
+
+  std::size_t num_set_bits() const noexcept {
+    return simd::popcount(words_.data(), words_.size());
+  }
+
+  std::size_t approximate_cardinality() const noexcept {
+    return bloom_filter<Key>::approximate_cardinality(Bits, num_set_bits(), K);
+  }
+
+  double approximate_fpp() const noexcept {
+    return bloom_filter<Key>::false_positive_probability(
+        Bits, approximate_cardinality(), K);
+  }
+
+  const std::array<word_type, num_words> &data() const noexcept {
+    return words_;
+  }
+
+  static_bloom_filter &operator&=(const static_bloom_filter &other) noexcept {
+    for (size_type i = 0; i < num_words; ++i) words_[i] &= other.words_[i];
+    return *this;
+  }
+  static_bloom_filter operator&(const static_bloom_filter &other) const {
+    static_bloom_filter res(*this);
+    res &= other;
+    return res;
+  }
+  static_bloom_filter &operator|=(const static_bloom_filter &other) noexcept {
+    for (size_type i = 0; i < num_words; ++i) words_[i] |= other.words_[i];
+    return *this;
+  }
+  static_bloom_filter operator|(const static_bloom_filter &other) const {
+    static_bloom_filter res(*this);
+    res |= other;
+    return res;
+  }
+
+  bool operator==(const static_bloom_filter &) const = default;
+
+ private:
+  bool test(std::pair<std::uint32_t, std::uint32_t> h) const noexcept {
+    const auto [h1, h2] = h;
+    return [&]<std::size_t... I>(std::index_sequence<I...>) {
+      return ((words_[position<I>(h1, h2) >> bits_per_word_log2] &
+               (word_type{1} << (position<I>(h1, h2) & word_mask))) &&
+              ...);
+    }(std::make_index_sequence<K>{});
+  }
+  template <typename T>
+  static std::pair<std::uint32_t, std::uint32_t> split(const T &key) noexcept {
+    // An odd stride visits every position of a power of two sized filter.
+    if constexpr (std::numeric_limits<typename Hash::hash_type>::digits >= 64) {
+      const std::uint64_t h = Hash{}(key, 0);
+      return {static_cast<std::uint32_t>(h),
+              static_cast<std::uint32_t>(h >> 32) | 1u};
+    } else {
+      return {static_cast<std::uint32_t>(Hash{}(key, 0)),
+              static_cast<std::uint32_t>(Hash{}(key, 1)) | 1u};
+    }
+  }
+  template <std::size_t I>
+  static constexpr size_type position(std::uint32_t h1,
+                                      std::uint32_t h2) noexcept {
+    return static_cast<size_type>(
+        (std::uint64_t{h1} + I * std::uint64_t{h2}) % Bits);
+  }
+
+  std::array<word_type, num_words> words_{};
+};
+
+}  // namespace pds
+#endif
@@ -0,0 +1,289 @@
+#ifndef PDS_XOR_FILTER_HPP
+#define PDS_XOR_FILTER_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "hash.hpp"
+#include "simd.hpp"
+
+// Xor filter (Graf and Lemire, "Xor Filters: Faster and Smaller Than Bloom
+// and Cuckoo Filters"): a static set of keys, built once from all of them.
+// Every key maps to three slots, one in each third of an array of about
+// 1.23 n fingerprints, chosen so that the xor of the three is the key's
+// fingerprint. A lookup is three independent loads and a compare, the false
+// positive probability is 2^-bits for bits-bit fingerprints, and the filter
+// takes about 1.23 * bits bits per key, against 1.44 * log2(1/fpp) for an
+// optimal Bloom filter.
+//
+// Construction hashes every key once and then runs in linear time by peeling
+// slots that only one key maps to. If the peel gets stuck, it is retried
+// with another seed, which only remixes the stored hashes.
+
+namespace pds {
+
+namespace xor_detail {
+
+// Finalizer of MurmurHash3: remixes a key's hash with the construction seed.
+inline std::uint64_t mix(std::uint64_t h) noexcept {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+template <std::unsigned_integral Fingerprint>
+inline Fingerprint fingerprint(std::uint64_t h) noexcept {
+  return static_cast<Fingerprint>(h ^ (h >> 32));
+}
+
+// Maps the 32 bits of h selected by rotation r to [0, range).
+inline std::uint32_t reduce(std::uint64_t h, int r,
+                            std::uint32_t range) noexcept {
+  return static_cast<std::uint32_t>(
+      (std::uint64_t{static_cast<std::uint32_t>(std::rotl(h, r))} * range) >>
+      32);
+}
+
+// Seeds of the construction attempts; any odd constants will do.
+inline std::uint64_t attempt_seed(unsigned attempt) noexcept {
+  return mix(0x9e3779b97f4a7c15ULL * (attempt + 1)) | 1u;
+}
+
+// Key lookups of the filters that are built from the 64-bit Hash output of
+// every key under seed 0 (xor, binary fuse and ribbon filters). Derived
+// provides contains_hash, the lookup by that output, e.g. when it is stored
+// alongside the key.
+template <typename Derived, typename Key, typename Hash>
+class hashed_lookup {
+ public:
+  bool contains(const Key &key) const noexcept {
+    return derived().contains_hash(hash_key(key));
+  }
+  template <hash::TransparentKey<Key> K>
+    requires std::invocable<Hash, const K &, typename Hash::seed_type>
+  bool contains(const K &key) const noexcept {
+    return derived().contains_hash(hash_key(key));
+  }
+
+ protected:
+  template <typename K>
+  static std::uint64_t hash_key(const K &key) noexcept {
+    return static_cast<std::uint64_t>(Hash{}(key, 0));
+  }
+
+ private:
+  const Derived &derived() const noexcept {
+    return static_cast<const Derived &>(*this);
+  }
+};
+
+}  // namespace xor_detail
+
+template <typename Key, std::unsigned_integral Fingerprint = std::uint8_t,
+          hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>,
+          typename Allocator = std::allocator<Fingerprint>>
+class xor_filter
+    : public xor_detail::hashed_lookup<
+          xor_filter<Key, Fingerprint, Hash, Allocator>, Key, Hash> {
+ public:
+  using key_type = Key;
+  using fingerprint_type = Fingerprint;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using hash_function_type = Hash;
+
+  static_assert(std::numeric_limits<typename Hash::hash_type>::digits >= 64,
+                "xor filters need a 64-bit hash");
+
+  static constexpr size_type fingerprint_bits =
+      std::numeric_limits<Fingerprint>::digits;
+  static constexpr size_type hashes_per_key = 3;
+  // Construction fails with probability well below 1% per attempt.
+  static constexpr unsigned max_attempts = 64;
+  // Keys hashed ahead of the slot updates during construction.
+  static constexpr size_type prefetch_distance = 16;
+
+  static constexpr double false_positive_probability() noexcept {
+    return 1.0 / static_cast<double>(std::uint64_t{1} << fingerprint_bits);
+  }
+
+  // Builds the filter from the keys in [first, last). Duplicate keys are
+  // allowed. Throws std::length_error above 2^32 slots and
+  // std::runtime_error if no seed leads to a successful peel, which with
+  // distinct keys does not happen in practice.
+  template <std::forward_iterator It>
+  xor_filter(It first, It last, const Allocator &alloc = Allocator())
+      : fingerprints_(alloc) {
+    const auto n = static_cast<size_type>(std::distance(first, last));
+    const size_type capacity = 32 + n + (n * 23 + 99) / 100;
+    if (capacity > std::numeric_limits<std::uint32_t>::max())
+      throw std::length_error("xor_filter: too many keys");
+    segment_length_ = static_cast<std::uint32_t>(capacity / 3);
+    fingerprints_.assign(size_type{segment_length_} * 3, 0);
+
+    using hash_allocator = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<std::uint64_t>;
+    std::vector<std::uint64_t, hash_allocator> hashes(hash_allocator{alloc});
+    hashes.reserve(n);
+    for (auto it = first; it != last; ++it)
+      hashes.push_back(this->hash_key(*it));
+    build(hashes, alloc);
+  }
+  explicit xor_filter(std::span<const Key> keys,
+                      const Allocator &alloc = Allocator())
+      : xor_filter(keys.begin(), keys.end(), alloc) {}
+
+  bool contains_hash(std::uint64_t key_hash) const noexcept {
+    const std::uint64_t h = xor_detail::mix(key_hash + seed_);
+    const auto [i0, i1, i2] = slots(h);
+    return xor_detail::fingerprint<Fingerprint>(h) ==
+           static_cast<Fingerprint>(fingerprints_[i0] ^ fingerprints_[i1] ^
+                                    fingerprints_[i2]);
+  }
+
+  // Number of distinct key hashes the filter was built from.
+  size_type size() const noexcept { return size_; }
+  size_type num_slots() const noexcept { return fingerprints_.size(); }
+  size_type size_in_bytes() const noexcept {
+    return fingerprints_.size() * sizeof(Fingerprint);
+  }
+  double bits_per_key() const noexcept {
+    return size_ ? 8.0 * static_cast<double>(size_in_bytes()) /
+                       static_cast<double>(size_)
+                 : 0.0;
+  }
+  std::uint64_t seed() const noexcept { return seed_; }
+
+ private:
+  struct slot_triple {
+    std::uint32_t i0, i1, i2;
+  };
+  // Construction state of a slot: the xor of the hashes of the keys mapping
+  // to it and their number. Once one key is left, the xor names it without
+  // any further lookup. Both share a cache line.
+  struct slot_state {
+    std::uint64_t xor_hash = 0;
+    std::uint32_t count = 0;
+  };
+  slot_triple slots(std::uint64_t h) const noexcept {
+    return {xor_detail::reduce(h, 0, segment_length_),
+            xor_detail::reduce(h, 21, segment_length_) + segment_length_,
+            xor_detail::reduce(h, 42, segment_length_) + 2 * segment_length_};
+  }
+
+  template <typename HashVector>
+  void build(HashVector &hashes, const Allocator &alloc) {
+    using rebind = std::allocator_traits<Allocator>;
+    using u32_allocator = typename rebind::template rebind_alloc<std::uint32_t>;
+    using u64_allocator = typename rebind::template rebind_alloc<std::uint64_t>;
+    using slot_allocator = typename rebind::template rebind_alloc<slot_state>;
+    const size_type capacity = fingerprints_.size();
+    std::vector<slot_state, slot_allocator> state(capacity,
+                                                  slot_allocator{alloc});
+    std::vector<std::uint32_t, u32_allocator> queue(u32_allocator{alloc});
+    queue.reserve(capacity);
+    // Peeled keys in order, each with the slot it was peeled from.
+    std::vector<std::uint64_t, u64_allocator> stack_hash(u64_allocator{alloc});
+    std::vector<std::uint32_t, u32_allocator> stack_slot(u32_allocator{alloc});
+    stack_hash.reserve(hashes.size());
+    stack_slot.reserve(hashes.size());
+
+    for (unsigned attempt = 0; attempt < max_attempts; ++attempt) {
+      // Equal key hashes map to equal slots and can never be peeled, so
+      // after two failures assume duplicates and drop them.
+      if (attempt == 2) {
+        std::sort(hashes.begin(), hashes.end());
+        hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+      }
+      seed_ = xor_detail::attempt_seed(attempt);
+      std::fill(state.begin(), state.end(), slot_state{});
+      // Slots are prefetched prefetch_distance keys ahead, so the cache
+      // misses of consecutive keys overlap.
+      const size_type n = hashes.size();
+      for (size_type j = 0; j < n; ++j) {
+        if (j + prefetch_distance < n) {
+          const auto [p0, p1, p2] = slots(
+              xor_detail::mix(hashes[j + prefetch_distance] + seed_));
+          for (auto p : {p0, p1, p2}) simd::prefetch_write(&state[p]);
+        }
+        const std::uint64_t h = xor_detail::mix(hashes[j] + seed_);
+        const auto [i0, i1, i2] = slots(h);
+        for (auto i : {i0, i1, i2}) {
+          state[i].xor_hash ^= h;
+          ++state[i].count;
+        }
+      }
+
+      queue.clear();
+      for (std::uint32_t i = 0; i < capacity; ++i)
+        if (state[i].count == 1) queue.push_back(i);
+      stack_hash.clear();
+      stack_slot.clear();
+      // Peels the queue prefetch_distance slots at a time, prefetching the
+      // slots of all their keys first: peeling in any order gives a valid
+      // result, and the cache misses of the batch overlap.
+      while (!queue.empty()) {
+        const size_type batch = std::min(queue.size(), prefetch_distance);
+        std::uint32_t peel[prefetch_distance];
+        for (size_type b = 0; b < batch; ++b) {
+          peel[b] = queue.back();
+          queue.pop_back();
+          const auto [p0, p1, p2] = slots(state[peel[b]].xor_hash);
+          for (auto p : {p0, p1, p2}) simd::prefetch_write(&state[p]);
+        }
+        for (size_type b = 0; b < batch; ++b) {
+          const std::uint32_t slot = peel[b];
+          if (state[slot].count != 1) continue;
+          const std::uint64_t h = state[slot].xor_hash;
+          stack_hash.push_back(h);
+          stack_slot.push_back(slot);
+          const auto [i0, i1, i2] = slots(h);
+          for (auto i : {i0, i1, i2}) {
+            state[i].xor_hash ^= h;
+            if (--state[i].count == 1) queue.push_back(i);
+          }
+        }
+      }
+      if (stack_hash.size() != hashes.size()) continue;
+
+      // Assign in reverse peel order: each key's slot is the last of its
+      // three to be written, so it can absorb the other two.
+      std::fill(fingerprints_.begin(), fingerprints_.end(), 0);
+      for (size_type j = stack_hash.size(); j-- > 0;) {
+        const std::uint64_t h = stack_hash[j];
+        const auto [i0, i1, i2] = slots(h);
+        fingerprints_[stack_slot[j]] = static_cast<Fingerprint>(
+            xor_detail::fingerprint<Fingerprint>(h) ^ fingerprints_[i0] ^
+            fingerprints_[i1] ^ fingerprints_[i2]);
+      }
+      size_ = hashes.size();
+      return;
+    }
+    throw std::runtime_error("xor_filter: construction failed");
+  }
+
+  std::vector<Fingerprint, Allocator> fingerprints_;
+  std::uint32_t segment_length_ = 0;
+  std::uint64_t seed_ = 0;
+  size_type size_ = 0;
+};
+
+template <typename Key, hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>>
+using xor8_filter = xor_filter<Key, std::uint8_t, Hash>;
+template <typename Key, hash::HashFunction<Key> Hash = hash::murmer3_x64_128<Key>>
+using xor16_filter = xor_filter<Key, std::uint16_t, Hash>;
+
+}  // namespace pds
+#endif
@@ -0,0 +1,102 @@
+#include "binary_fuse_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include "test_keys.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <list>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+template <typename Filter>
+void check_contains_every_key() {
+    for (std::size_t n : {0, 1, 2, 3, 10, 100, 1000, 100000, 1000000}) {
+        const auto keys = random_keys(n, n);
+        Filter filter(keys.begin(), keys.end());
+        EXPECT_EQ(filter.size(), n);
+        for (auto key : keys) ASSERT_TRUE(filter.contains(key)) << n;
+    }
+}
+
+template <typename Filter>
+void check_slots_in_consecutive_segments() {
+    const auto keys = random_keys(100000, 2);
+    Filter filter(keys.begin(), keys.end());
+    const auto length = filter.segment_length();
+    EXPECT_EQ(std::popcount(length), 1);
+    EXPECT_EQ(filter.num_slots() % length, 0u);
+    for (auto key : keys) {
+        const auto slots = filter.key_slots(key);
+        for (std::size_t j = 0; j < slots.size(); ++j) {
+            ASSERT_LT(slots[j], filter.num_slots());
+            ASSERT_EQ(slots[j] / length, slots[0] / length + j) << key;
+        }
+    }
+}
+
+}  // namespace
+
+TEST(binary_fuse_filter, ContainsEveryKey) {
+    check_contains_every_key<pds::binary_fuse8_filter<uint64_t>>();
+    check_contains_every_key<pds::binary_fuse8_filter<uint64_t, 4>>();
+    check_contains_every_key<pds::binary_fuse16_filter<uint64_t>>();
+    check_contains_every_key<pds::binary_fuse16_filter<uint64_t, 4>>();
+}
+
+TEST(binary_fuse_filter, SpaceAndFalsePositiveRate) {
+    const auto keys = random_keys(1000000, 1);
+    pds::binary_fuse8_filter<uint64_t> fuse3(keys.begin(), keys.end());
+    pds::binary_fuse8_filter<uint64_t, 4> fuse4(keys.begin(), keys.end());
+    pds::binary_fuse16_filter<uint64_t> fuse16(keys.begin(), keys.end());
+    EXPECT_LT(fuse3.bits_per_key(), 9.2);
+    EXPECT_LT(fuse4.bits_per_key(), 8.8);
+    EXPECT_LT(fuse16.bits_per_key(), 18.4);
+    EXPECT_NEAR(false_positive_rate(fuse3, 1000000),
+                fuse3.false_positive_probability(), 0.001);
+    EXPECT_NEAR(false_positive_rate(fuse4, 1000000),
+                fuse4.false_positive_probability(), 0.001);
+    EXPECT_LT(false_positive_rate(fuse16, 1000000), 0.0001);
+}
+
+TEST(binary_fuse_filter, SlotsStayWithinNeighbouringSegments) {
+    check_slots_in_consecutive_segments<pds::binary_fuse8_filter<uint64_t>>();
+    check_slots_in_consecutive_segments<
+        pds::binary_fuse8_filter<uint64_t, 4>>();
+}
+
+TEST(binary_fuse_filter, ThreadCountDoesNotChangeTheFilter) {
+    const auto keys = random_keys(200000, 3);
+    pds::binary_fuse8_filter<uint64_t> one(keys.begin(), keys.end(), 1);
+    pds::binary_fuse8_filter<uint64_t> four(keys.begin(), keys.end(), 4);
+    const std::list<uint64_t> linked(keys.begin(), keys.end());
+    pds::binary_fuse8_filter<uint64_t> forward(linked.begin(), linked.end());
+    EXPECT_EQ(one.seed(), four.seed());
+    EXPECT_EQ(one.seed(), forward.seed());
+    const auto probes = random_keys(100000, 4);
+    for (auto key : probes) {
+        EXPECT_EQ(one.contains(key), four.contains(key));
+        EXPECT_EQ(one.contains(key), forward.contains(key));
+    }
+}
+
+TEST(binary_fuse_filter, DuplicateKeys) {
+    std::vector<int> keys(5000);
+    std::iota(keys.begin(), keys.end(), 0);
+    keys.insert(keys.end(), keys.begin(), keys.begin() + 2500);
+    pds::binary_fuse16_filter<int, 4> filter(keys);
+    EXPECT_EQ(filter.size(), 5000u);
+    for (int key = 0; key < 5000; ++key) EXPECT_TRUE(filter.contains(key));
+}
+
+TEST(binary_fuse_filter, StringKeys) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; ++i) keys.push_back("key number " + std::to_string(i));
+    pds::binary_fuse8_filter<std::string> filter(keys.begin(), keys.end());
+    for (const auto &key : keys) EXPECT_TRUE(filter.contains(std::string_view(key)));
+}
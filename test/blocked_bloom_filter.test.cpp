@@ -0,0 +1,95 @@
+#include "blocked_bloom_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <bit>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+TEST(blocked_bloom_filter, ContainsInsertedKeys) {
+    pds::blocked_bloom_filter<int> bf(1000, 0.01);
+    for (int i = 0; i < 1000; ++i) bf.insert(i);
+    for (int i = 0; i < 1000; ++i) EXPECT_TRUE(bf.contains(i));
+}
+
+TEST(blocked_bloom_filter, SizeIsWholeBlocks) {
+    pds::blocked_bloom_filter<int> bf(1000, (size_t)4);
+    EXPECT_EQ(bf.bit_capacity() % 512, 0);
+    EXPECT_GE(bf.bit_capacity(), 1000);
+    EXPECT_TRUE(std::has_single_bit(bf.num_blocks()));
+    EXPECT_TRUE(bf.empty());
+}
+
+TEST(blocked_bloom_filter, KeySetsBitsInOneBlock) {
+    pds::blocked_bloom_filter<int> bf(1 << 16, (size_t)6);
+    for (int key = 0; key < 100; ++key) {
+        bf.clear();
+        bf.insert(key);
+        auto touched = 0;
+        for (const auto &block : bf.data()) {
+            auto bits = 0;
+            for (auto word : block.words) bits += std::popcount(word);
+            if (bits) ++touched;
+        }
+        EXPECT_EQ(touched, 1);
+        EXPECT_LE(bf.num_set_bits(), bf.hashes_per_key());
+    }
+}
+
+TEST(blocked_bloom_filter, FalsePositiveRate) {
+    pds::blocked_bloom_filter<int> bf(10000, 0.01);
+    for (int i = 0; i < 10000; ++i) bf.insert(2 * i);
+    auto fp = 0;
+    for (int i = 0; i < 10000; ++i) fp += bf.contains(2 * i + 1);
+    EXPECT_LT(fp / 10000.0, 0.05);
+}
+
+TEST(blocked_bloom_filter, Union) {
+    pds::blocked_bloom_filter<int> a(1000, (size_t)4), b(1000, (size_t)4);
+    a.insert(1);
+    b.insert(2);
+    auto c = a | b;
+    EXPECT_TRUE(c.contains(1));
+    EXPECT_TRUE(c.contains(2));
+    a &= b;
+    EXPECT_FALSE(a.contains(1) && !b.contains(1));
+}
+
+TEST(blocked_bloom_filter, BatchMatchesSingleKeyOperations) {
+    std::vector<int> keys(1000);
+    std::iota(keys.begin(), keys.end(), 0);
+    pds::blocked_bloom_filter<int> bf(1000, 0.01);
+    bf.insert_batch(std::span<const int>(keys).first(500));
+    sul::dynamic_bitset<> bits(keys.size());
+    bf.contains_batch(keys, bits);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        EXPECT_EQ(bits[i], bf.contains(keys[i]));
+        if (i < 500) {
+            EXPECT_TRUE(bits[i]);
+        }
+    }
+}
+
+TEST(blocked_bloom_filter, ParallelBuildMatchesSequential) {
+    std::vector<int> keys(200000);
+    std::iota(keys.begin(), keys.end(), 0);
+    pds::blocked_bloom_filter<int> sequential(keys.size(), 0.01),
+        parallel(keys.size(), 0.01);
+    sequential.insert(keys.begin(), keys.end());
+    parallel.insert_parallel(keys.begin(), keys.end(), 4);
+    ASSERT_EQ(parallel.num_blocks(), sequential.num_blocks());
+    for (std::size_t i = 0; i < sequential.num_blocks(); ++i) {
+        EXPECT_TRUE(std::ranges::equal(parallel.data()[i].words,
+                                       sequential.data()[i].words));
+    }
+}
+
+TEST(blocked_bloom_filter, StringViewLookups) {
+    pds::blocked_bloom_filter<std::string> bf(1000, 0.01);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; ++i) keys.push_back(std::to_string(i) + " keys");
+    bf.insert(keys.begin(), keys.end());
+    for (const auto &key : keys) EXPECT_TRUE(bf.contains(std::string_view(key)));
+}
@@ -2,8 +2,264 @@
 
 #include <gtest/gtest.h>
 
+#include <bit>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
 TEST(bloom_filter, CorrectSize) {
     pds::bloom_filter<int> bf(100, (size_t)4);
     bf.insert(2);
     EXPECT_EQ(bf.contains(2), true);
 }
+
+TEST(bloom_filter, BatchMatchesSingleKeyOperations) {
+    std::vector<int> keys(1000);
+    std::iota(keys.begin(), keys.end(), 0);
+    pds::bloom_filter<int> single(1000, 0.01), batched(1000, 0.01);
+    for (int i = 0; i < 500; ++i) single.insert(keys[i]);
+    batched.insert_batch(std::span<const int>(keys).first(500));
+    EXPECT_EQ(single.data(), batched.data());
+
+    auto storage = std::make_unique<bool[]>(keys.size());
+    std::span<bool> results(storage.get(), keys.size());
+    sul::dynamic_bitset<> bits(keys.size());
+    auto hits = batched.contains_batch(keys, results);
+    EXPECT_EQ(batched.contains_batch(keys, bits), hits);
+    EXPECT_EQ(bits.count(), hits);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        EXPECT_EQ(results[i], batched.contains(keys[i]));
+        EXPECT_EQ(bits[i], batched.contains(keys[i]));
+    }
+}
+
+TEST(bloom_filter, BatchSmallerThanWindow) {
+    pds::bloom_filter<int> bf(100, 0.01);
+    std::vector<int> keys = {1, 2, 3};
+    bf.insert_batch(keys);
+    sul::dynamic_bitset<> bits(keys.size());
+    EXPECT_EQ(bf.contains_batch(keys, bits), 3);
+    EXPECT_EQ(bf.contains_batch(std::span<const int>{}, bits), 0);
+}
+
+TEST(bloom_filter, BatchWithManyHashesGoesKeyByKey) {
+    std::vector<int> keys(100);
+    std::iota(keys.begin(), keys.end(), 0);
+    pds::bloom_filter<int> single(std::size_t{1} << 16, std::size_t{40}),
+        batched(std::size_t{1} << 16, std::size_t{40});
+    ASSERT_GT(batched.hashes_per_key(), batched.max_batch_hashes);
+    for (int i = 0; i < 50; ++i) single.insert(keys[i]);
+    batched.insert_batch(std::span<const int>(keys).first(50));
+    EXPECT_EQ(single.data(), batched.data());
+    sul::dynamic_bitset<> bits(keys.size());
+    batched.contains_batch(keys, bits);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        EXPECT_EQ(bits[i], batched.contains(keys[i]));
+}
+
+TEST(bloom_filter, DoubleHashGeneratorDropIn) {
+    pds::bloom_filter<int, pds::hash::enhanced_double_hash_generator<int>> bf(
+        1000, 0.01);
+    for (int i = 0; i < 1000; ++i) bf.insert(2 * i);
+    auto fp = 0;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(bf.contains(2 * i));
+        fp += bf.contains(2 * i + 1);
+    }
+    EXPECT_LT(fp, 50);
+}
+
+TEST(bloom_filter, UnionAndIntersection) {
+    pds::bloom_filter<int> a(std::size_t{1} << 14, std::size_t{3}),
+        b(std::size_t{1} << 14, std::size_t{3});
+    for (int i = 0; i < 1000; ++i) a.insert(i);
+    for (int i = 500; i < 1500; ++i) b.insert(i);
+
+    const auto u = a | b;
+    const auto n = a & b;
+    for (int i = 0; i < 1500; ++i) EXPECT_TRUE(u.contains(i));
+    for (int i = 500; i < 1000; ++i) EXPECT_TRUE(n.contains(i));
+    for (std::size_t w = 0; w < a.data().size(); ++w) {
+        EXPECT_EQ(u.data()[w], a.data()[w] | b.data()[w]);
+        EXPECT_EQ(n.data()[w], a.data()[w] & b.data()[w]);
+    }
+
+    auto dst = a;
+    dst.unite(b, b);
+    EXPECT_EQ(dst.data(), b.data());
+    dst.intersect(a, b);
+    EXPECT_EQ(dst.data(), n.data());
+    auto in_place = a;
+    in_place |= b;
+    EXPECT_EQ(in_place.data(), u.data());
+    in_place &= a;
+    EXPECT_EQ(in_place.data(), a.data());
+}
+
+TEST(bloom_filter, KernelsAgreeAcrossIsas) {
+    // Odd length to exercise the scalar tails.
+    std::vector<unsigned long> a(1037), b(1037), expected(1037), out(1037);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a[i] = i * 0x9E3779B97F4A7C15ul;
+        b[i] = ~i * 0xC2B2AE3D27D4EB4Ful;
+    }
+    pds::simd::apply<pds::simd::bit_or>(expected.data(), a.data(), b.data(),
+                                        a.size(), pds::simd::isa::scalar);
+    for (auto target : {pds::simd::isa::avx2, pds::simd::isa::avx512}) {
+        if (!pds::simd::supports(target)) continue;
+        pds::simd::apply<pds::simd::bit_or>(out.data(), a.data(), b.data(),
+                                            a.size(), target);
+        EXPECT_EQ(out, expected);
+    }
+}
+
+TEST(bloom_filter, MergeAllMatchesRepeatedUnion) {
+    // Larger than one reduce chunk.
+    std::vector<pds::bloom_filter<int>> shards;
+    for (int s = 0; s < 9; ++s) {
+        shards.emplace_back(std::size_t{1} << 17, std::size_t{4});
+        for (int i = 0; i < 2000; ++i) shards.back().insert(s * 2000 + i);
+    }
+    pds::bloom_filter<int> expected(std::size_t{1} << 17, std::size_t{4});
+    for (const auto &shard : shards) expected |= shard;
+
+    std::vector<const pds::bloom_filter<int> *> inputs;
+    for (const auto &shard : shards) inputs.push_back(&shard);
+    pds::bloom_filter<int> merged(std::size_t{1} << 17, std::size_t{4});
+    merged.merge_all(inputs);
+    EXPECT_EQ(merged.data(), expected.data());
+    for (int i = 0; i < 18000; ++i) EXPECT_TRUE(merged.contains(i));
+}
+
+TEST(bloom_filter, PopcountMatchesWordByWord) {
+    pds::bloom_filter<int> bf(std::size_t{1} << 16, std::size_t{5});
+    for (int i = 0; i < 3000; ++i) bf.insert(i * 13);
+    std::size_t expected = 0;
+    for (auto word : bf.data()) expected += std::popcount(word);
+    EXPECT_EQ(bf.num_set_bits(), expected);
+}
+
+TEST(bloom_filter, TrackedSetBitsStayExact) {
+    using tracked = pds::bloom_filter<int, pds::hash::default_hash_generator<int>,
+                                      std::allocator<unsigned long>,
+                                      pds::bloom_filter_policy::power_of_two,
+                                      true>;
+    auto scanned = [](const tracked &bf) {
+        std::size_t n = 0;
+        for (auto word : bf.data()) n += std::popcount(word);
+        return n;
+    };
+    tracked a(std::size_t{1} << 15, std::size_t{4}),
+        b(std::size_t{1} << 15, std::size_t{4});
+    EXPECT_EQ(a.num_set_bits(), 0);
+    for (int i = 0; i < 2000; ++i) a.insert(i);
+    for (int i = 0; i < 2000; ++i) a.insert(i);  // duplicates set nothing new
+    EXPECT_EQ(a.num_set_bits(), scanned(a));
+
+    std::vector<int> keys(3000);
+    std::iota(keys.begin(), keys.end(), 1000);
+    b.insert_batch(keys);
+    EXPECT_EQ(b.num_set_bits(), scanned(b));
+
+    a |= b;
+    EXPECT_EQ(a.num_set_bits(), scanned(a));
+    const auto both = a & b;
+    EXPECT_EQ(both.num_set_bits(), scanned(both));
+    a.clear();
+    EXPECT_EQ(a.num_set_bits(), 0);
+    EXPECT_EQ(b.approximate_cardinality(),
+              decltype(b)::approximate_cardinality(
+                  b.bit_capacity(), scanned(b), b.hashes_per_key()));
+}
+
+TEST(bloom_filter, ParallelBuildMatchesSequential) {
+    std::vector<int> keys(300000);
+    std::iota(keys.begin(), keys.end(), -1000);
+    for (unsigned threads : {1u, 2u, 3u, 8u}) {
+        // Odd size: regions do not divide the array evenly.
+        pds::bloom_filter<int, pds::hash::default_hash_generator<int>,
+                          std::allocator<unsigned long>,
+                          pds::bloom_filter_policy::exact, true>
+            sequential(std::size_t{3000017}, std::size_t{5}),
+            parallel(std::size_t{3000017}, std::size_t{5});
+        sequential.insert(keys.begin(), keys.end());
+        parallel.insert_parallel(keys.begin(), keys.end(), threads);
+        EXPECT_EQ(parallel.data(), sequential.data()) << threads;
+        EXPECT_EQ(parallel.num_set_bits(), sequential.num_set_bits());
+    }
+}
+
+TEST(bloom_filter, ParallelBuildRethrowsWorkerExceptions) {
+    std::vector<int> keys(300000);
+    std::iota(keys.begin(), keys.end(), 0);
+    for (int bad : {0, 150000, 299999}) {
+        auto positions = [bad](int key, std::size_t *out) {
+            if (key == bad) throw std::runtime_error("bad key");
+            out[0] = static_cast<std::size_t>(key);
+        };
+        EXPECT_THROW(pds::parallel_build::set_bits(keys.begin(), keys.end(),
+                                                   keys.size(), 1, 8,
+                                                   positions,
+                                                   [](std::size_t) {}),
+                     std::runtime_error)
+            << bad;
+    }
+}
+
+TEST(bloom_filter, StringKeysHashTheirCharacters) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; ++i)
+        keys.push_back("a key long enough for the heap #" + std::to_string(i));
+    pds::bloom_filter<std::string> bf(1000, 0.01);
+    bf.insert(keys.begin(), keys.end());
+    for (const auto &key : keys) {
+        // A copy has other storage but the same characters.
+        EXPECT_TRUE(bf.contains(std::string(key)));
+        EXPECT_TRUE(bf.contains(std::string_view(key)));
+    }
+    EXPECT_TRUE(bf.contains("a key long enough for the heap #7"));
+    std::size_t false_positives = 0;
+    for (int i = 1000; i < 11000; ++i)
+        false_positives += bf.contains(
+            std::string_view("a key long enough for the heap #" +
+                             std::to_string(i)));
+    EXPECT_LT(false_positives, 300u);
+
+    pds::bloom_filter<std::string,
+                      pds::hash::double_hash_generator<std::string>>
+        dh(1000, 0.01);
+    dh.insert(keys.begin(), keys.end());
+    for (const auto &key : keys) EXPECT_TRUE(dh.contains(std::string_view(key)));
+}
+
+TEST(bloom_filter, PrehashedKeysProbeFiltersOfAnySize) {
+    using filter = pds::bloom_filter<int, pds::hash::double_hash_generator<int>>;
+    std::vector<filter> filters;
+    for (std::size_t i = 0; i < 40; ++i)
+        filters.emplace_back(1000 + 977 * i, std::size_t{3 + i % 5});
+    // Key k goes into filter k % 40 only, half of them through insert_hash.
+    for (int key = 0; key < 4000; ++key) {
+        auto &target = filters[key % 40];
+        if (key & 1)
+            target.insert(key);
+        else
+            target.insert_hash(pds::hash::prehash(key));
+    }
+    std::size_t false_positives = 0;
+    for (int key = 0; key < 4000; ++key) {
+        const auto prehashed = filters[0].prehash(key);
+        EXPECT_EQ(prehashed.h1, pds::hash::prehash(key).h1);
+        const std::uint64_t hits = filter::probe_all(prehashed, filters);
+        EXPECT_TRUE(hits >> (key % 40) & 1);
+        for (std::size_t i = 0; i < filters.size(); ++i) {
+            EXPECT_EQ(hits >> i & 1, filters[i].contains(key));
+            EXPECT_EQ(filters[i].contains_hash(prehashed), filters[i].contains(key));
+        }
+        false_positives += std::popcount(hits) - 1;
+    }
+    EXPECT_LT(false_positives, 4000u * 40 / 20);
+    EXPECT_EQ(filter::probe_all(filters[0].prehash(1), {}), 0u);
+}
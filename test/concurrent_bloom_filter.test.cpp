@@ -0,0 +1,41 @@
+#include "concurrent_bloom_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(concurrent_bloom_filter, ConcurrentInsertsAreAllVisible) {
+    constexpr int threads = 4, per_thread = 5000;
+    pds::concurrent_bloom_filter<int> bf(threads * per_thread, 0.01);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&bf, t] {
+            for (int i = 0; i < per_thread; ++i) bf.insert(t * per_thread + i);
+        });
+    }
+    for (auto &w : workers) w.join();
+    for (int i = 0; i < threads * per_thread; ++i) EXPECT_TRUE(bf.contains(i));
+}
+
+TEST(concurrent_bloom_filter, SnapshotMatchesSequentialBuild) {
+    pds::concurrent_bloom_filter<int> cbf(1000, 0.01);
+    pds::bloom_filter<int> bf(cbf.hash_generator());
+    for (int i = 0; i < 1000; ++i) {
+        cbf.insert(i);
+        bf.insert(i);
+    }
+    auto snapshot = cbf.snapshot();
+    EXPECT_EQ(snapshot.data(), bf.data());
+    EXPECT_EQ(cbf.num_set_bits(), bf.num_set_bits());
+}
+
+TEST(concurrent_bloom_filter, MergeBloomFilter) {
+    pds::concurrent_bloom_filter<int> cbf(1000, (size_t)3);
+    pds::bloom_filter<int> bf(cbf.hash_generator());
+    bf.insert(17);
+    cbf.insert(4);
+    cbf |= bf;
+    EXPECT_TRUE(cbf.contains(17));
+    EXPECT_TRUE(cbf.contains(4));
+}
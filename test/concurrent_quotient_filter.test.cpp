@@ -0,0 +1,138 @@
+#include "concurrent_quotient_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include "test_keys.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using filter_type = pds::concurrent_quotient_filter<uint64_t>;
+
+}  // namespace
+
+TEST(concurrent_quotient_filter, SnapshotMatchesSequentialBuild) {
+    // 2^16 slots, 16 regions, with small remainders for long clusters that
+    // cross region boundaries.
+    constexpr int threads = 4, per_thread = 14000;
+    const auto keys = random_keys(threads * per_thread, 1);
+    filter_type filter(std::size_t{16}, std::size_t{4});
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = t * per_thread; i < (t + 1) * per_thread; ++i)
+                filter.insert(keys[i], i % 50 ? 1 : i);
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    pds::quotient_filter<uint64_t> sequential(std::size_t{16}, std::size_t{4});
+    for (int i = 0; i < threads * per_thread; ++i)
+        sequential.insert(keys[i], i % 50 ? 1 : i);
+    EXPECT_EQ(filter.size(), sequential.size());
+    EXPECT_EQ(filter.num_fingerprints(), sequential.num_fingerprints());
+    EXPECT_EQ(filter.slots_used(), sequential.slots_used());
+    const auto snapshot = filter.snapshot();
+    EXPECT_EQ(snapshot.slots_used(), sequential.slots_used());
+    for (auto key : keys) ASSERT_EQ(filter.count(key), sequential.count(key));
+    for (auto key : random_keys(100000, 2)) {
+        ASSERT_EQ(filter.count(key), sequential.count(key));
+        ASSERT_EQ(snapshot.count(key), sequential.count(key));
+    }
+}
+
+TEST(concurrent_quotient_filter, LookupsDuringWritesFindEveryKey) {
+    const auto stable = random_keys(20000, 3);
+    const auto churn = random_keys(20000, 4);
+    filter_type filter(std::size_t{16}, std::size_t{6});
+    filter.insert(stable.begin(), stable.end());
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 2; ++t) {
+        writers.emplace_back([&, t] {
+            for (int round = 0; round < 3; ++round) {
+                for (std::size_t i = t; i < churn.size(); i += 2)
+                    filter.insert(churn[i]);
+                for (std::size_t i = t; i < churn.size(); i += 2)
+                    EXPECT_TRUE(filter.erase(churn[i]));
+            }
+        });
+    }
+    std::thread reader([&] {
+        std::size_t misses = 0;
+        while (!done.load()) {
+            for (auto key : stable) misses += !filter.contains(key);
+        }
+        EXPECT_EQ(misses, 0u);
+    });
+    for (auto &w : writers) w.join();
+    done = true;
+    reader.join();
+    EXPECT_EQ(filter.size(), stable.size());
+    for (auto key : stable) EXPECT_TRUE(filter.contains(key));
+}
+
+TEST(concurrent_quotient_filter, InserterBuffersBusyRegions) {
+    // One region, so threads contend for it all the time.
+    constexpr int threads = 4, per_thread = 500;
+    const auto keys = random_keys(threads * per_thread, 5);
+    filter_type filter(std::size_t{12}, std::size_t{8});
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            filter_type::inserter inserter(filter);
+            for (int i = t * per_thread; i < (t + 1) * per_thread; ++i)
+                inserter.insert(keys[i]);
+            inserter.flush();
+            EXPECT_EQ(inserter.pending(), 0u);
+        });
+    }
+    for (auto &w : workers) w.join();
+    EXPECT_EQ(filter.size(), keys.size());
+    for (auto key : keys) EXPECT_TRUE(filter.contains(key));
+}
+
+TEST(concurrent_quotient_filter, FullFilterThrows) {
+    filter_type filter(std::size_t{8}, std::size_t{8});
+    const auto keys = random_keys(300, 6);
+    std::size_t inserted = 0;
+    try {
+        for (auto key : keys) {
+            filter.insert(key);
+            ++inserted;
+        }
+    } catch (const std::length_error &) {
+    }
+    EXPECT_LT(inserted, keys.size());
+    EXPECT_EQ(filter.size(), inserted);
+    EXPECT_EQ(filter.snapshot().size(), inserted);
+    for (std::size_t i = 0; i < inserted; ++i)
+        EXPECT_TRUE(filter.contains(keys[i]));
+
+    filter_type::inserter inserter(filter);
+    EXPECT_THROW(
+        {
+            for (auto key : keys) inserter.insert(key);
+        },
+        std::length_error);
+}
+
+TEST(concurrent_quotient_filter, AdoptsBuiltFilter) {
+    auto hashes = random_keys(1000, 7);
+    std::sort(hashes.begin(), hashes.end());
+    pds::quotient_filter<uint64_t> built(std::size_t{12}, std::size_t{8});
+    built.build_from_sorted(hashes);
+    filter_type filter(std::move(built));
+    EXPECT_EQ(filter.size(), hashes.size());
+    for (auto h : hashes) EXPECT_TRUE(filter.contains_hash(h));
+    const auto more = random_keys(1000, 8);
+    filter.insert(more.begin(), more.end());
+    EXPECT_EQ(filter.size(), 2000u);
+    for (auto key : more) EXPECT_TRUE(filter.contains(key));
+    for (auto h : hashes) EXPECT_TRUE(filter.contains_hash(h));
+}
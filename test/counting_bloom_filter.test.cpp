@@ -0,0 +1,62 @@
+#include "counting_bloom_filter.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(counting_bloom_filter, InsertErase) {
+    pds::counting_bloom_filter<int> cbf(1000, 0.01);
+    for (int i = 0; i < 1000; ++i) cbf.insert(i);
+    for (int i = 0; i < 1000; ++i) EXPECT_TRUE(cbf.contains(i));
+    for (int i = 0; i < 1000; ++i) EXPECT_TRUE(cbf.erase(i));
+    EXPECT_TRUE(cbf.empty());
+    EXPECT_FALSE(cbf.contains(1));
+    EXPECT_FALSE(cbf.erase(1));
+}
+
+TEST(counting_bloom_filter, CountEstimate) {
+    pds::counting_bloom_filter<int> cbf(1000, 0.01);
+    for (int i = 0; i < 5; ++i) cbf.insert(7);
+    EXPECT_GE(cbf.count_estimate(7), 5);
+    cbf.erase(7);
+    EXPECT_GE(cbf.count_estimate(7), 4);
+    EXPECT_EQ(cbf.count_estimate(8) == 0, !cbf.contains(8));
+}
+
+TEST(counting_bloom_filter, CountersSaturate) {
+    pds::counting_bloom_filter<int> cbf(1000, (size_t)3);
+    for (int i = 0; i < 40; ++i) cbf.insert(1);
+    EXPECT_EQ(cbf.count_estimate(1), 15);
+    // Saturated counters are never decremented.
+    for (int i = 0; i < 40; ++i) cbf.erase(1);
+    EXPECT_TRUE(cbf.contains(1));
+}
+
+TEST(counting_bloom_filter, ToBloomFilterMatchesDirectBuild) {
+    pds::counting_bloom_filter<int> cbf(5000, 0.01);
+    pds::bloom_filter<int> bf(cbf.hash_generator());
+    for (int i = 0; i < 5000; ++i) {
+        cbf.insert(3 * i);
+        bf.insert(3 * i);
+    }
+    for (int i = 0; i < 5000; i += 2) {
+        cbf.insert(3 * i + 1);
+        cbf.erase(3 * i + 1);
+    }
+    auto converted = cbf.to_bloom_filter();
+    EXPECT_EQ(converted.bit_capacity(), bf.bit_capacity());
+    EXPECT_EQ(converted.data(), bf.data());
+    EXPECT_EQ(converted.num_set_bits(), cbf.num_set_counters());
+}
+
+TEST(counting_bloom_filter, SaturatingMerge) {
+    pds::counting_bloom_filter<int> a(100, (size_t)2), b(100, (size_t)2);
+    for (int i = 0; i < 10; ++i) a.insert(1);
+    for (int i = 0; i < 10; ++i) b.insert(1);
+    b.insert(2);
+    a += b;
+    EXPECT_EQ(a.count_estimate(1), 15);
+    EXPECT_GE(a.count_estimate(2), 1);
+    pds::counting_bloom_filter<int> c(100, (size_t)2);
+    c.insert(3);
+    c += c;
+    EXPECT_EQ(c.count_estimate(3), 2);
+}
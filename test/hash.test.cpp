@@ -3,6 +3,8 @@
 #include <gtest/gtest.h>
 
 #include <random>
+#include <string>
+#include <string_view>
 
 using namespace pds::hash;
 
@@ -252,3 +254,139 @@ TEST(SimpleHashGeneratorTest, CollisionDetection) {
         }
     }
 }
+
+TEST(DoubleHashGeneratorTest, SatisfiesConcept) {
+    constexpr bool plain = HashGenerator<double_hash_generator<int>, int>;
+    constexpr bool enhanced =
+        HashGenerator<enhanced_double_hash_generator<int>, int>;
+    EXPECT_TRUE(plain);
+    EXPECT_TRUE(enhanced);
+}
+
+TEST(DoubleHashGeneratorTest, HashesStayInRange) {
+    double_hash_generator<int> plain(7, 1000);
+    enhanced_double_hash_generator<int> enhanced(7, 1000);
+    for (int key = 0; key < 1000; ++key) {
+        EXPECT_EQ(std::ranges::distance(plain.hashes(key)), 7);
+        for (auto h : plain.hashes(key)) EXPECT_LT(h, 1000u);
+        for (auto h : enhanced.hashes(key)) EXPECT_LT(h, 1000u);
+    }
+}
+
+TEST(DoubleHashGeneratorTest, ArithmeticProgression) {
+    // Without a range reduction consecutive positions differ by h2.
+    double_hash_generator<int> generator(4);
+    std::vector<uint64_t> h;
+    std::ranges::copy(generator.hashes(42), std::back_inserter(h));
+    EXPECT_EQ(h[1] - h[0], h[2] - h[1]);
+    EXPECT_EQ(h[2] - h[1], h[3] - h[2]);
+    EXPECT_EQ((h[1] - h[0]) & 1u, 1u);
+}
+
+TEST(DoubleHashGeneratorTest, SeedChangesHashes) {
+    double_hash_generator<int> a(3, 1 << 20, 1), b(3, 1 << 20, 2);
+    auto ha = a.hashes(5), hb = b.hashes(5);
+    EXPECT_FALSE(std::ranges::equal(ha, hb));
+    EXPECT_TRUE(std::ranges::equal(a.hashes(5), a.hashes(5)));
+}
+
+TEST(FastModRangeTest, MatchesModulo32) {
+    std::mt19937 rng(11);
+    for (uint32_t d : {1u, 2u, 3u, 7u, 1024u, 4026031u, 2147483647u,
+                       4294967291u, 4294967295u}) {
+        fast_mod_range<uint32_t> reduce(d);
+        for (uint32_t h : {0u, 1u, d - 1, d, 4294967295u})
+            EXPECT_EQ(reduce(h), h % d) << h << " % " << d;
+        for (int i = 0; i < 10000; ++i) {
+            const uint32_t h = rng();
+            EXPECT_EQ(reduce(h), h % d) << h << " % " << d;
+        }
+    }
+}
+
+TEST(FastModRangeTest, MatchesModulo64) {
+    std::mt19937_64 rng(12);
+    for (uint64_t d : {uint64_t{1}, uint64_t{2}, uint64_t{3},
+                       uint64_t{1} << 20, uint64_t{1741}, uint64_t{2364114217},
+                       uint64_t{8589934583}, uint64_t{18446744073709551557u},
+                       ~uint64_t{0}}) {
+        fast_mod_range<uint64_t> reduce(d);
+        for (uint64_t h : {uint64_t{0}, uint64_t{1}, d - 1, d, ~uint64_t{0}})
+            EXPECT_EQ(reduce(h), h % d) << h << " % " << d;
+        for (int i = 0; i < 10000; ++i) {
+            const uint64_t h = rng();
+            EXPECT_EQ(reduce(h), h % d) << h << " % " << d;
+        }
+    }
+}
+
+TEST(FastModRangeTest, StatefulRangeFunctionsPlugIntoGenerators) {
+    EXPECT_TRUE((StatefulRangeFunction<fast_mod_range<uint64_t>, uint64_t>));
+    EXPECT_TRUE((RangeFunction<fast_mod_range<uint32_t>, uint32_t>));
+    EXPECT_FALSE((StatefulRangeFunction<mod_range<uint64_t>, uint64_t>));
+
+    double_hash_generator<int> plain(5, 1741);
+    double_hash_generator<int, fast_mod_range<uint64_t>> fast(5, 1741);
+    simple_hash_generator<int, murmer3_x86_32<int>> simple(5, 976369);
+    simple_hash_generator<int, murmer3_x86_32<int>, fast_mod_range<uint32_t>>
+        simple_fast(5, 976369);
+    for (int key = 0; key < 1000; ++key) {
+        EXPECT_TRUE(std::ranges::equal(plain.hashes(key), fast.hashes(key)));
+        EXPECT_TRUE(
+            std::ranges::equal(simple.hashes(key), simple_fast.hashes(key)));
+    }
+}
+
+TEST(SeededHashGeneratorTest, SatisfiesConceptAndStaysInRange) {
+    using generator = seeded_hash_generator<int, murmer3_x86_32<int>>;
+    EXPECT_TRUE((HashGenerator<generator, int>));
+    generator g(6, 1000, 7);
+    EXPECT_EQ(g.range(), 1000u);
+    EXPECT_EQ(g.hashes_per_key(), 6u);
+    for (int key = 0; key < 1000; ++key) {
+        for (auto h : g.hashes(key)) EXPECT_LT(h, 1000u);
+    }
+    const std::vector<uint32_t> seeds = {1, 2, 3};
+    generator fixed(seeds, 500);
+    for (auto h : fixed.hashes(9)) EXPECT_LT(h, 500u);
+}
+
+TEST(KeyTraitsTest, ContiguousKeysHashTheirContents) {
+    // Longer than any small-string buffer, so the characters live on the heap
+    // at an address that differs between the two strings.
+    const std::string a(100, 'x'), b(100, 'x'), c(100, 'y');
+    murmer3_x64_128<std::string> h64;
+    murmer3_x86_32<std::string> h32;
+    EXPECT_EQ(h64(a, 1), h64(b, 1));
+    EXPECT_NE(h64(a, 1), h64(c, 1));
+    EXPECT_EQ(h32(a, 1), h32(b, 1));
+    EXPECT_EQ(h64(a, 1), h64(std::string_view(a), 1));
+    EXPECT_EQ(h32(a, 1), h32(std::string_view(a), 1));
+    EXPECT_EQ(key_traits<std::string>::bytes(a).size(), a.size());
+
+    const std::vector<int> v = {1, 2, 3};
+    const int raw[] = {1, 2, 3};
+    EXPECT_EQ(key_traits<std::vector<int>>::bytes(v).size(), sizeof(raw));
+    EXPECT_EQ(murmer3_x64_128<std::vector<int>>{}(v, 0),
+              murmer3_x64_128<std::vector<int>>{}(std::span<const int>(v), 0));
+    // Fixed-size keys still hash their object representation.
+    EXPECT_EQ(key_traits<uint64_t>::bytes(uint64_t{7}).size(), 8u);
+}
+
+TEST(KeyTraitsTest, TransparentKeys) {
+    EXPECT_TRUE((TransparentKey<std::string_view, std::string>));
+    EXPECT_TRUE((TransparentKey<std::span<const std::byte>,
+                                std::vector<std::byte>>));
+    EXPECT_FALSE((TransparentKey<std::string, std::string>));
+    EXPECT_FALSE((TransparentKey<char[4], std::string>));
+    EXPECT_FALSE((TransparentKey<std::u16string_view, std::string>));
+    EXPECT_FALSE((TransparentKey<std::string_view, int>));
+
+    double_hash_generator<std::string> g(4, 1 << 20);
+    simple_hash_generator<std::string, murmer3_x86_32<std::string>> s(4, 1000);
+    const std::string key = "a key long enough to be heap allocated, surely";
+    EXPECT_TRUE(std::ranges::equal(g.hashes(key),
+                                   g.hashes(std::string_view(key))));
+    EXPECT_TRUE(std::ranges::equal(s.hashes(key),
+                                   s.hashes(std::string_view(key))));
+}
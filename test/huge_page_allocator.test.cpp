@@ -0,0 +1,85 @@
+#include "huge_page_allocator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "blocked_bloom_filter.hpp"
+#include "bloom_filter.hpp"
+#include "counting_bloom_filter.hpp"
+#include "split_block_bloom_filter.hpp"
+
+namespace {
+
+bool aligned_to(const void *p, std::size_t alignment) {
+    return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+}
+
+}  // namespace
+
+TEST(aligned_allocator, AlignsToCacheLine) {
+    for (std::size_t n : {1, 3, 100, 4097}) {
+        std::vector<unsigned long, pds::aligned_allocator<unsigned long>> v(n);
+        EXPECT_TRUE(aligned_to(v.data(), 64));
+    }
+    std::vector<char, pds::aligned_allocator<char, 4096>> page(10);
+    EXPECT_TRUE(aligned_to(page.data(), 4096));
+}
+
+TEST(huge_page_allocator, SmallAllocationsAreCacheLineAligned) {
+    pds::huge_page_allocator<unsigned long> alloc;
+    auto *p = alloc.allocate(10);
+    EXPECT_TRUE(aligned_to(p, 64));
+    alloc.deallocate(p, 10);
+}
+
+TEST(huge_page_allocator, LargeAllocationsAreHugePageAligned) {
+    pds::huge_page_allocator<unsigned long> alloc;
+    const std::size_t n = (std::size_t{5} << 20) / sizeof(unsigned long);
+    auto *p = alloc.allocate(n);
+    EXPECT_TRUE(aligned_to(p, pds::huge_page_allocator<int>::huge_page_size));
+    for (std::size_t i = 0; i < n; i += 512) p[i] = i;
+    for (std::size_t i = 0; i < n; i += 512) EXPECT_EQ(p[i], i);
+    alloc.deallocate(p, n);
+}
+
+TEST(huge_page_allocator, ExplicitPolicyFallsBack) {
+    // Succeeds whether or not the machine has a huge page pool reserved.
+    pds::huge_page_allocator<unsigned long,
+                             pds::huge_page_policy::explicit_then_transparent>
+        alloc;
+    const std::size_t n = (std::size_t{4} << 20) / sizeof(unsigned long);
+    auto *p = alloc.allocate(n);
+    ASSERT_NE(p, nullptr);
+    p[0] = 1;
+    p[n - 1] = 2;
+    EXPECT_EQ(p[0] + p[n - 1], 3);
+    alloc.deallocate(p, n);
+}
+
+TEST(huge_page_allocator, PlugsIntoFilters) {
+    using alloc = pds::huge_page_allocator<unsigned long>;
+    using generator = pds::hash::default_hash_generator<int>;
+    pds::bloom_filter<int, generator, alloc> bf(std::size_t{1} << 25,
+                                                std::size_t{4});
+    pds::blocked_bloom_filter<int, generator, alloc> blocked(
+        std::size_t{1} << 25, std::size_t{4});
+    pds::counting_bloom_filter<int, generator, alloc> counting(1000, 0.01);
+    pds::split_block_bloom_filter<int, pds::hash::murmer3_x64_128<int>, alloc>
+        split(std::size_t{1} << 25, 0u);
+    for (int i = 0; i < 10000; ++i) {
+        bf.insert(i);
+        blocked.insert(i);
+        counting.insert(i);
+        split.insert(i);
+    }
+    for (int i = 0; i < 10000; ++i) {
+        EXPECT_TRUE(bf.contains(i));
+        EXPECT_TRUE(blocked.contains(i));
+        EXPECT_TRUE(counting.contains(i));
+        EXPECT_TRUE(split.contains(i));
+    }
+    EXPECT_TRUE(aligned_to(bf.data().data(), alloc::huge_page_size));
+    EXPECT_TRUE(aligned_to(blocked.data().data(), alloc::huge_page_size));
+}
@@ -0,0 +1,104 @@
+#include "mapped_bloom_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+std::string temp_path(const std::string &name) {
+    return (std::filesystem::temp_directory_path() /
+            ("pds_" + name + "_" + std::to_string(::getpid())))
+        .string();
+}
+
+}  // namespace
+
+TEST(mapped_bloom_filter, MapsRawBitArray) {
+    pds::bloom_filter<int> bf(1000, 0.01);
+    for (int i = 0; i < 1000; ++i) bf.insert(2 * i);
+    const auto path = temp_path("raw");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(bf.data().data()),
+                  bf.data().size() * sizeof(unsigned long));
+    }
+    pds::mapped_bloom_filter<int> mapped(path, bf.hash_generator());
+    EXPECT_FALSE(mapped.writable());
+    EXPECT_EQ(mapped.num_set_bits(), bf.num_set_bits());
+    for (int i = 0; i < 2000; ++i) EXPECT_EQ(mapped.contains(i), bf.contains(i));
+    std::filesystem::remove(path);
+}
+
+TEST(mapped_bloom_filter, ReadWriteMappingPersists) {
+    const auto path = temp_path("rw");
+    pds::hash::default_hash_generator<int> generator(4, 1 << 14);
+    {
+        auto mapped = pds::mapped_bloom_filter<int>::create(path, generator);
+        EXPECT_TRUE(mapped.writable());
+        for (int i = 0; i < 500; ++i) mapped.insert(i);
+        mapped.update_checksum();
+        mapped.sync();
+    }
+    pds::map_options options;
+    options.populate = true;
+    options.advice = pds::access_advice::will_need;
+    auto mapped = pds::mapped_bloom_filter<int>::open(path, options);
+    EXPECT_TRUE(mapped.verify());
+    EXPECT_EQ(mapped.bit_capacity(), generator.range());
+    EXPECT_EQ(mapped.hashes_per_key(), generator.hashes_per_key());
+    for (int i = 0; i < 500; ++i) EXPECT_TRUE(mapped.contains(i));
+    EXPECT_FALSE(mapped.writable());
+    EXPECT_THROW(mapped.insert(1000), std::logic_error);
+    const int keys[] = {1000, 1001};
+    EXPECT_THROW(mapped.insert(std::begin(keys), std::end(keys)),
+                 std::logic_error);
+    EXPECT_THROW(mapped.update_checksum(), std::logic_error);
+    std::filesystem::remove(path);
+}
+
+TEST(mapped_bloom_filter, OpensSavedFilter) {
+    pds::bloom_filter<int, pds::hash::double_hash_generator<int>> bf(3000,
+                                                                     0.01);
+    for (int i = 0; i < 3000; ++i) bf.insert(3 * i);
+    const auto path = temp_path("saved");
+    {
+        std::ofstream out(path, std::ios::binary);
+        pds::serialization::save(out, bf);
+    }
+    auto mapped =
+        pds::mapped_bloom_filter<int, pds::hash::double_hash_generator<int>>::
+            open(path);
+    EXPECT_TRUE(mapped.verify());
+    EXPECT_EQ(mapped.num_set_bits(), bf.num_set_bits());
+    for (int i = 0; i < 9000; ++i) EXPECT_EQ(mapped.contains(i), bf.contains(i));
+
+    // Flip one payload bit behind the mapping's back.
+    {
+        std::fstream io(path, std::ios::in | std::ios::out | std::ios::binary);
+        io.seekg(pds::serialization::payload_offset);
+        const char byte = static_cast<char>(io.get() ^ 0x01);
+        io.seekp(pds::serialization::payload_offset);
+        io.put(byte);
+    }
+    EXPECT_FALSE(
+        (pds::mapped_bloom_filter<int, pds::hash::double_hash_generator<int>>::
+             open(path)
+                 .verify()));
+    std::filesystem::remove(path);
+}
+
+TEST(mapped_bloom_filter, RejectsShortFiles) {
+    const auto path = temp_path("short");
+    { std::ofstream out(path, std::ios::binary); out << "tiny"; }
+    pds::hash::default_hash_generator<int> generator(4, 1 << 14);
+    EXPECT_THROW(pds::mapped_bloom_filter<int>(path, generator),
+                 std::length_error);
+    std::filesystem::remove(path);
+    EXPECT_THROW(pds::mapped_bloom_filter<int>(path, generator),
+                 std::system_error);
+}
@@ -0,0 +1,372 @@
+#include "quotient_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include "test_keys.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Keys that are their own hash, so tests can place fingerprints directly.
+struct identity_hash {
+    using key_type = uint64_t;
+    using hash_type = uint64_t;
+    using seed_type = uint32_t;
+    uint64_t operator()(const uint64_t &key, uint32_t) const { return key; }
+};
+
+using identity_filter = pds::quotient_filter<uint64_t, identity_hash>;
+
+}  // namespace
+
+TEST(quotient_filter, ContainsEveryKey) {
+    for (std::size_t n : {0, 1, 2, 10, 1000, 60000}) {
+        const auto keys = random_keys(n, n);
+        pds::quotient_filter<uint64_t> filter(std::size_t{16}, std::size_t{10});
+        filter.insert(keys.begin(), keys.end());
+        EXPECT_EQ(filter.size(), n);
+        for (auto key : keys) EXPECT_TRUE(filter.contains(key));
+    }
+}
+
+TEST(quotient_filter, FalsePositiveRate) {
+    const auto keys = random_keys(120000, 1);
+    pds::quotient_filter<uint64_t> filter(keys.size(), 0.01);
+    filter.insert(keys.begin(), keys.end());
+    EXPECT_LE(filter.load_factor(), filter.max_load_factor());
+    const auto probes = random_keys(1000000, 2);
+    std::size_t hits = 0;
+    for (auto key : probes) hits += filter.contains(key);
+    EXPECT_NEAR(hits / 1e6, filter.false_positive_probability(),
+                0.15 * filter.false_positive_probability());
+    EXPECT_LT(hits / 1e6, 0.01);
+}
+
+TEST(quotient_filter, MatchesMultisetOfFingerprints) {
+    // 2^8 home slots with 4-bit remainders: long clusters, frequent equal
+    // fingerprints and runs spilling into the slack blocks.
+    identity_filter filter(std::size_t{8}, std::size_t{4});
+    std::map<uint64_t, int> model;
+    std::mt19937_64 rng(3);
+    const auto fingerprint = [&] {
+        // Skewed towards the last home slots.
+        const uint64_t quotient = rng() % 4 ? 192 + rng() % 64 : rng() % 256;
+        return (quotient << 56) | ((rng() % 16) << 52);
+    };
+    for (int round = 0; round < 20000; ++round) {
+        const uint64_t h = fingerprint();
+        if (rng() % 3 && filter.slots_used() < filter.capacity()) {
+            filter.insert(h);
+            ++model[h];
+        } else {
+            EXPECT_EQ(filter.erase(h), model[h] > 0);
+            if (model[h] > 0) --model[h];
+        }
+        if (round % 500 == 0) {
+            std::size_t total = 0;
+            for (uint64_t q = 0; q < 256; ++q) {
+                for (uint64_t r = 0; r < 16; ++r) {
+                    const uint64_t probe = (q << 56) | (r << 52);
+                    ASSERT_EQ(filter.count(probe), uint64_t(model[probe]));
+                    ASSERT_EQ(filter.contains(probe), model[probe] > 0);
+                    total += model[probe];
+                }
+            }
+            ASSERT_EQ(filter.size(), total);
+        }
+    }
+}
+
+TEST(quotient_filter, EraseKeepsKeysWithEqualFingerprints) {
+    identity_filter filter(std::size_t{10}, std::size_t{8});
+    const uint64_t a = 0x1234'0000'0000'0000, b = a | 1;
+    filter.insert(a);
+    filter.insert(b);
+    EXPECT_TRUE(filter.erase(a));
+    EXPECT_TRUE(filter.contains(a));
+    EXPECT_TRUE(filter.erase(b));
+    EXPECT_FALSE(filter.contains(a));
+    EXPECT_FALSE(filter.erase(a));
+    EXPECT_TRUE(filter.empty());
+}
+
+TEST(quotient_filter, EraseRestoresEmptyFilter) {
+    const auto keys = random_keys(3000, 4);
+    pds::quotient_filter<uint64_t> filter(std::size_t{12}, std::size_t{8});
+    filter.insert(keys.begin(), keys.end());
+    for (std::size_t i = 0; i < keys.size(); i += 2)
+        EXPECT_TRUE(filter.erase(keys[i]));
+    for (std::size_t i = 1; i < keys.size(); i += 2)
+        EXPECT_TRUE(filter.contains(keys[i]));
+    for (std::size_t i = 1; i < keys.size(); i += 2)
+        EXPECT_TRUE(filter.erase(keys[i]));
+    EXPECT_TRUE(filter.empty());
+    for (auto key : keys) EXPECT_FALSE(filter.contains(key));
+}
+
+TEST(quotient_filter, LoadFactor) {
+    pds::quotient_filter<uint64_t> filter(std::size_t{10}, std::size_t{6});
+    EXPECT_EQ(filter.num_slots(), 1024u);
+    filter.max_load_factor(0.5);
+    EXPECT_EQ(filter.capacity(), 512u);
+    const auto keys = random_keys(513, 5);
+    filter.insert(keys.begin(), keys.end() - 1);
+    EXPECT_DOUBLE_EQ(filter.load_factor(), 0.5);
+    EXPECT_THROW(filter.insert(keys.back()), std::length_error);
+    EXPECT_EQ(filter.size(), 512u);
+    EXPECT_THROW(filter.max_load_factor(1.5), std::invalid_argument);
+    filter.clear();
+    EXPECT_TRUE(filter.empty());
+    EXPECT_FALSE(filter.contains(keys[0]));
+}
+
+TEST(quotient_filter, InvalidGeometry) {
+    using filter = pds::quotient_filter<uint64_t>;
+    EXPECT_THROW(filter(std::size_t{0}, std::size_t{8}), std::invalid_argument);
+    EXPECT_THROW(filter(std::size_t{8}, std::size_t{1}), std::invalid_argument);
+    EXPECT_THROW(filter(std::size_t{32}, std::size_t{33}),
+                 std::invalid_argument);
+}
+
+TEST(quotient_filter, WideRemainders) {
+    // Remainders straddling words of the packed array.
+    for (std::size_t r : {7, 13, 31, 50}) {
+        const auto keys = random_keys(1900, r);
+        pds::quotient_filter<uint64_t> filter(std::size_t{11}, r);
+        filter.insert(keys.begin(), keys.end());
+        for (auto key : keys) EXPECT_TRUE(filter.contains(key));
+        std::size_t hits = 0;
+        for (auto key : random_keys(10000, 100 + r)) hits += filter.contains(key);
+        EXPECT_LT(hits, r > 10 ? 5u : 200u);
+    }
+}
+
+TEST(quotient_filter, CountsMatchMultisetWithSmallRemainders) {
+    // Two and three bit remainders give counter digits in base 3 and 7,
+    // including remainder 0 and digits equal to the remainder's value.
+    for (std::size_t r : {2, 3}) {
+        identity_filter filter(std::size_t{6}, r);
+        std::map<uint64_t, uint64_t> model;
+        std::mt19937_64 rng(r);
+        for (int round = 0; round < 4000; ++round) {
+            const uint64_t h = ((rng() % 64) << 58) | ((rng() % (1u << r)) << (58 - r));
+            const uint64_t n = rng() % 4 ? 1 : rng() % 1000;
+            if (rng() % 3) {
+                if (filter.slots_used() + 8 > filter.capacity()) continue;
+                filter.insert(h, n);
+                model[h] += n;
+            } else {
+                const uint64_t removed = std::min(n, model[h]);
+                ASSERT_EQ(filter.erase(h, n), removed);
+                model[h] -= removed;
+            }
+            ASSERT_EQ(filter.count(h), model[h]);
+        }
+        uint64_t total = 0, distinct = 0;
+        for (auto [h, n] : model) {
+            ASSERT_EQ(filter.count(h), n);
+            total += n;
+            distinct += n > 0;
+        }
+        EXPECT_EQ(filter.size(), total);
+        EXPECT_EQ(filter.num_fingerprints(), distinct);
+    }
+}
+
+TEST(quotient_filter, LargeCountsTakeFewSlots) {
+    const auto keys = random_keys(1000, 6);
+    pds::quotient_filter<uint64_t> filter(std::size_t{12}, std::size_t{20});
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        filter.insert(keys[i], i % 100 ? 1 : uint64_t{1} << (i / 100 * 6));
+    EXPECT_EQ(filter.num_fingerprints(), keys.size());
+    // 990 single slots and ten counters of at most 2 + 4 digits in base
+    // 2^20 - 1.
+    EXPECT_LE(filter.slots_used(), 990u + 10 * 6);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        EXPECT_EQ(filter.count(keys[i]), i % 100 ? 1 : uint64_t{1} << (i / 100 * 6));
+    filter.insert(keys[0], ~uint64_t{0} - 1);
+    EXPECT_EQ(filter.count(keys[0]), ~uint64_t{0});
+    EXPECT_EQ(filter.erase(keys[0], ~uint64_t{0}), ~uint64_t{0});
+    EXPECT_FALSE(filter.contains(keys[0]));
+}
+
+TEST(quotient_filter, FullFilterIsUnchangedByFailedInsert) {
+    identity_filter filter(std::size_t{8}, std::size_t{8});
+    filter.max_load_factor(1.0);
+    // Every key in the last home slot, so the run spills through the slack.
+    uint64_t r = 0;
+    while (true) {
+        const uint64_t h = (uint64_t{255} << 56) | (r++ << 48);
+        try {
+            filter.insert(h, 1000);
+        } catch (const std::length_error &) {
+            EXPECT_EQ(filter.count(h), 0u);
+            break;
+        }
+    }
+    for (uint64_t i = 0; i + 1 < r; ++i)
+        EXPECT_EQ(filter.count((uint64_t{255} << 56) | (i << 48)), 1000u);
+    EXPECT_EQ(filter.num_fingerprints(), r - 1);
+}
+
+TEST(quotient_filter, ExpandKeepsKeysAndCounts) {
+    const auto keys = random_keys(3000, 7);
+    pds::quotient_filter<uint64_t> filter(std::size_t{12}, std::size_t{14});
+    // Direct builds of the expanded geometries, for reference.
+    pds::quotient_filter<uint64_t> twice(std::size_t{13}, std::size_t{13}),
+        four_times(std::size_t{14}, std::size_t{12});
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        const uint64_t n = i % 10 ? 1 : i + 2;
+        filter.insert(keys[i], n);
+        twice.insert(keys[i], n);
+        four_times.insert(keys[i], n);
+    }
+    const double fpp = filter.false_positive_probability();
+
+    filter.expand();
+    EXPECT_EQ(filter.quotient_bits(), 13u);
+    EXPECT_EQ(filter.remainder_bits(), 13u);
+    EXPECT_EQ(filter.size(), twice.size());
+    EXPECT_EQ(filter.num_fingerprints(), twice.num_fingerprints());
+    EXPECT_EQ(filter.slots_used(), twice.slots_used());
+    EXPECT_DOUBLE_EQ(filter.false_positive_probability(), fpp);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        ASSERT_EQ(filter.count(keys[i]), twice.count(keys[i]));
+
+    filter.expand();
+    EXPECT_EQ(filter.slots_used(), four_times.slots_used());
+    const auto probes = random_keys(100000, 8);
+    for (auto key : probes) ASSERT_EQ(filter.count(key), four_times.count(key));
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        ASSERT_EQ(filter.count(keys[i]), four_times.count(keys[i]));
+
+    // Inserts and erases carry on as in any filter of that geometry.
+    const auto more = random_keys(8000, 9);
+    filter.insert(more.begin(), more.end());
+    for (auto key : more) EXPECT_TRUE(filter.contains(key));
+    for (auto key : keys) EXPECT_TRUE(filter.erase(key));
+    for (auto key : more) EXPECT_TRUE(filter.contains(key));
+}
+
+TEST(quotient_filter, ExpandDownToTwoRemainderBits) {
+    identity_filter filter(std::size_t{6}, std::size_t{4});
+    filter.insert(uint64_t{0}, 5);
+    filter.insert(~uint64_t{0}, 7);
+    filter.expand();
+    filter.expand();
+    EXPECT_EQ(filter.remainder_bits(), 2u);
+    EXPECT_EQ(filter.count(uint64_t{0}), 5u);
+    EXPECT_EQ(filter.count(~uint64_t{0}), 7u);
+    EXPECT_THROW(filter.expand(), std::length_error);
+    EXPECT_EQ(filter.num_slots(), 256u);
+
+    identity_filter empty(std::size_t{6}, std::size_t{4});
+    empty.expand();
+    EXPECT_TRUE(empty.empty());
+    EXPECT_FALSE(empty.contains(uint64_t{0}));
+}
+
+TEST(quotient_filter, BuildFromSortedMatchesInserts) {
+    auto hashes = random_keys(3000, 10);
+    for (std::size_t i = 0; i < 3000; i += 7)
+        hashes.insert(hashes.end(), 4, hashes[i]);
+    identity_filter inserted(std::size_t{12}, std::size_t{6});
+    inserted.insert(hashes.begin(), hashes.end());
+    std::sort(hashes.begin(), hashes.end());
+    identity_filter built(std::size_t{12}, std::size_t{6});
+    built.insert(uint64_t{42});
+    built.build_from_sorted(hashes);
+    EXPECT_EQ(built.size(), hashes.size());
+    EXPECT_EQ(built.num_fingerprints(), inserted.num_fingerprints());
+    EXPECT_EQ(built.slots_used(), inserted.slots_used());
+    for (auto h : random_keys(100000, 11))
+        ASSERT_EQ(built.count(h), inserted.count(h));
+    for (auto h : hashes) ASSERT_EQ(built.count(h), inserted.count(h));
+
+    // The result is an ordinary filter.
+    built.insert(uint64_t{42});
+    for (auto h : hashes) ASSERT_TRUE(built.erase(h));
+    EXPECT_TRUE(built.erase(uint64_t{42}));
+    EXPECT_TRUE(built.empty());
+    EXPECT_EQ(built.slots_used(), 0u);
+}
+
+TEST(quotient_filter, BuildFromSortedFailuresLeaveFilterEmpty) {
+    identity_filter filter(std::size_t{8}, std::size_t{8});
+    filter.insert(uint64_t{1});
+    const std::vector<uint64_t> unsorted = {3, 2};
+    EXPECT_THROW(filter.build_from_sorted(unsorted), std::invalid_argument);
+    EXPECT_TRUE(filter.empty());
+    EXPECT_FALSE(filter.contains(uint64_t{3}));
+
+    auto hashes = random_keys(300, 12);
+    std::sort(hashes.begin(), hashes.end());
+    EXPECT_THROW(filter.build_from_sorted(hashes), std::length_error);
+    EXPECT_TRUE(filter.empty());
+    EXPECT_EQ(filter.slots_used(), 0u);
+    hashes.resize(200);
+    filter.build_from_sorted(hashes);
+    for (auto h : hashes) EXPECT_TRUE(filter.contains(h));
+}
+
+TEST(quotient_filter, MergeSumsCounts) {
+    const auto keys = random_keys(2500, 13);
+    const std::vector<uint64_t> left(keys.begin(), keys.begin() + 1500),
+        right(keys.begin() + 1000, keys.end());
+    // Geometries with the same 18 fingerprint bits, and with more.
+    identity_filter a(std::size_t{12}, std::size_t{6}),
+        b(std::size_t{11}, std::size_t{7}),
+        wide(std::size_t{12}, std::size_t{9});
+    identity_filter reference(std::size_t{12}, std::size_t{6});
+    for (std::size_t i = 0; i < left.size(); ++i) {
+        a.insert(left[i], i % 5 ? 1 : 4);
+        reference.insert(left[i], i % 5 ? 1 : 4);
+    }
+    b.insert(right.begin(), right.end());
+    wide.insert(right.begin(), right.end());
+    reference.insert(right.begin(), right.end());
+
+    identity_filter merged(std::size_t{12}, std::size_t{6});
+    for (const auto *other : {&b, &wide}) {
+        merged.merge(a, *other);
+        EXPECT_EQ(merged.size(), reference.size());
+        EXPECT_EQ(merged.num_fingerprints(), reference.num_fingerprints());
+        EXPECT_EQ(merged.slots_used(), reference.slots_used());
+        for (auto h : keys) ASSERT_EQ(merged.count(h), reference.count(h));
+        for (auto h : random_keys(100000, 14))
+            ASSERT_EQ(merged.count(h), reference.count(h));
+    }
+
+    // Merging into one of the inputs, and with an empty filter.
+    a.merge(a, b);
+    for (auto h : keys) ASSERT_EQ(a.count(h), reference.count(h));
+    identity_filter empty(std::size_t{10}, std::size_t{8});
+    merged.merge(empty, a);
+    EXPECT_EQ(merged.slots_used(), reference.slots_used());
+    for (auto h : keys) ASSERT_EQ(merged.count(h), reference.count(h));
+
+    identity_filter narrow(std::size_t{12}, std::size_t{5}),
+        reseeded(std::size_t{12}, std::size_t{6}, 1);
+    EXPECT_THROW(merged.merge(a, narrow), std::invalid_argument);
+    EXPECT_THROW(merged.merge(a, reseeded), std::invalid_argument);
+}
+
+TEST(quotient_filter, StringKeys) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; ++i) keys.push_back("key number " + std::to_string(i));
+    pds::quotient_filter<std::string> filter(keys.size(), 0.01);
+    filter.insert(keys.begin(), keys.end());
+    for (const auto &key : keys) {
+        EXPECT_TRUE(filter.contains(key));
+        EXPECT_TRUE(filter.contains(std::string_view(key)));
+        EXPECT_GE(filter.count(std::string_view(key)), 1u);
+    }
+}
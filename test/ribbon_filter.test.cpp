@@ -0,0 +1,100 @@
+#include "ribbon_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include "test_keys.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using pds::simd::isa;
+
+TEST(ribbon_filter, ContainsEveryKey) {
+    for (std::size_t n : {0, 1, 2, 10, 1000, 100000}) {
+        const auto keys = random_keys(n, n);
+        pds::ribbon_filter<uint64_t> narrow(keys.begin(), keys.end(), 7.0);
+        pds::ribbon_filter<uint64_t, 128> wide(keys.begin(), keys.end(), 7.0);
+        EXPECT_EQ(narrow.size(), n);
+        for (auto key : keys) {
+            EXPECT_TRUE(narrow.contains(key));
+            EXPECT_TRUE(wide.contains(key));
+        }
+    }
+}
+
+TEST(ribbon_filter, SpaceAndFalsePositiveRate) {
+    const auto keys = random_keys(200000, 1);
+    for (double fpp : {0.01, 0.001}) {
+        using narrow_filter = pds::ribbon_filter<uint64_t>;
+        using wide_filter = pds::ribbon_filter<uint64_t, 128>;
+        narrow_filter narrow(keys.begin(), keys.end(),
+                             narrow_filter::bits_per_key_for(fpp));
+        wide_filter wide(keys.begin(), keys.end(),
+                         wide_filter::bits_per_key_for(fpp));
+        // Below the 1.44 * log2(1 / fpp) of a Bloom filter.
+        EXPECT_LT(narrow.bits_per_key(), 1.2 * std::log2(1 / fpp));
+        EXPECT_LT(wide.bits_per_key(), narrow.bits_per_key());
+        EXPECT_LT(false_positive_rate(narrow, 1000000), 1.2 * fpp);
+        EXPECT_LT(false_positive_rate(wide, 1000000), 1.2 * fpp);
+    }
+}
+
+TEST(ribbon_filter, FractionalBitsPerKey) {
+    const auto keys = random_keys(100000, 2);
+    double previous = 1.0;
+    for (double bits : {6.0, 6.5, 7.0, 7.5}) {
+        pds::ribbon_filter<uint64_t> filter(keys.begin(), keys.end(), bits);
+        EXPECT_NEAR(filter.bits_per_key(), bits, 0.1);
+        const double rate = false_positive_rate(filter, 1000000);
+        EXPECT_LT(rate, previous);
+        EXPECT_NEAR(rate, filter.false_positive_probability(),
+                    0.2 * filter.false_positive_probability());
+        previous = rate;
+    }
+}
+
+TEST(ribbon_filter, BatchMatchesSingleKeyLookupsOnEveryIsa) {
+    const auto keys = random_keys(20000, 3);
+    // Up to 14 columns, so the AVX-512 kernel takes its masked tail.
+    for (double bits : {3.3, 8.0, 14.5}) {
+        pds::ribbon_filter<uint64_t> filter(keys.begin(), keys.begin() + 10000,
+                                            bits);
+        filter.set_isa(isa::scalar);
+        std::vector<bool> expected;
+        for (auto key : keys) expected.push_back(filter.contains(key));
+        for (auto path : {isa::scalar, isa::avx2, isa::avx512}) {
+            if (!pds::simd::supports(path)) continue;
+            filter.set_isa(path);
+            EXPECT_EQ(filter.isa(), path);
+            auto results = std::make_unique<bool[]>(keys.size());
+            filter.contains_batch(keys, {results.get(), keys.size()});
+            sul::dynamic_bitset<> bits_out(keys.size());
+            filter.contains_batch(keys, bits_out);
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                ASSERT_EQ(filter.contains(keys[i]), expected[i]);
+                ASSERT_EQ(results[i], expected[i]);
+                ASSERT_EQ(bits_out[i], expected[i]);
+            }
+        }
+    }
+}
+
+TEST(ribbon_filter, InvalidBitsPerKey) {
+    const auto keys = random_keys(10, 4);
+    using filter = pds::ribbon_filter<uint64_t>;
+    EXPECT_THROW(filter(keys.begin(), keys.end(), 0.0), std::invalid_argument);
+    EXPECT_THROW(filter(keys.begin(), keys.end(), 70.0), std::invalid_argument);
+}
+
+TEST(ribbon_filter, StringKeys) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; ++i) keys.push_back("key number " + std::to_string(i));
+    pds::ribbon_filter<std::string> filter(keys.begin(), keys.end(), 8.0);
+    for (const auto &key : keys) {
+        EXPECT_TRUE(filter.contains(key));
+        EXPECT_TRUE(filter.contains(std::string_view(key)));
+    }
+}
@@ -0,0 +1,144 @@
+#include "scalable_bloom_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <vector>
+
+TEST(scalable_bloom_filter, GrowsPastInitialCapacity) {
+    pds::scalable_bloom_filter<int> bf(1000, 0.01);
+    EXPECT_EQ(bf.num_stages(), 1);
+    for (int i = 0; i < 1000; ++i) bf.insert(i);
+    EXPECT_EQ(bf.num_stages(), 1);
+    bf.insert(1000);
+    EXPECT_EQ(bf.num_stages(), 2);
+    for (int i = 1001; i < 31000; ++i) bf.insert(i);
+    // 1000 + 2000 + 4000 + 8000 + 16000 = 31000
+    EXPECT_EQ(bf.num_stages(), 5);
+    EXPECT_EQ(bf.size(), 31000);
+    EXPECT_EQ(bf.stage_capacity(4), 16000);
+    for (int i = 0; i < 31000; ++i) EXPECT_TRUE(bf.contains(i));
+}
+
+TEST(scalable_bloom_filter, StageProbabilitiesSumToTarget) {
+    pds::scalable_bloom_filter<int> bf(100, 0.01);
+    double sum = 0;
+    for (std::size_t i = 0; i < 200; ++i)
+        sum += bf.stage_false_positive_probability(i);
+    EXPECT_NEAR(sum, 0.01, 1e-9);
+    EXPECT_LT(bf.stage_false_positive_probability(1),
+              bf.stage_false_positive_probability(0));
+}
+
+template <typename Stage>
+double measured_fpp(bool fused) {
+    pds::scalable_options options;
+    options.initial_capacity = 1000;
+    options.false_positive_probability = 0.01;
+    options.fused = fused;
+    pds::scalable_bloom_filter<int, Stage> bf(options);
+    const int n = 100000;
+    for (int i = 0; i < n; ++i) bf.insert(i);
+    int false_positives = 0;
+    for (int i = n; i < 3 * n; ++i) false_positives += bf.contains(i);
+    return static_cast<double>(false_positives) / (2 * n);
+}
+
+TEST(scalable_bloom_filter, FalsePositiveRateStaysBounded) {
+    // Overfilling a fixed filter by 100x would make nearly every lookup a
+    // false positive.
+    EXPECT_LT(measured_fpp<pds::bloom_filter<int>>(false), 0.01);
+    // Blocked stages trade a somewhat higher rate for one miss per stage.
+    EXPECT_LT(measured_fpp<pds::blocked_bloom_filter<int>>(false), 0.02);
+}
+
+template <typename Stage>
+void expect_fused_matches(pds::scalable_options options) {
+    pds::scalable_bloom_filter<int, Stage> bf(options);
+    for (int i = 0; i < 20000; ++i) bf.insert(3 * i);
+    ASSERT_GT(bf.num_stages(), 3);
+    for (int i = 0; i < 20000; ++i) ASSERT_TRUE(bf.contains(3 * i)) << i;
+    bf.set_fused(false);
+    std::vector<bool> plain;
+    for (int i = 0; i < 60000; ++i) plain.push_back(bf.contains(i));
+    bf.set_fused(true);
+    for (int i = 0; i < 60000; ++i) EXPECT_EQ(bf.contains(i), plain[i]) << i;
+}
+
+TEST(scalable_bloom_filter, FusedLookupMatchesPerStageLookup) {
+    pds::scalable_options options;
+    options.initial_capacity = 500;
+    options.false_positive_probability = 0.01;
+    options.fused = true;
+    expect_fused_matches<pds::blocked_bloom_filter<int>>(options);
+    expect_fused_matches<pds::bloom_filter<int>>(options);
+    expect_fused_matches<pds::blocked_bloom_filter<
+        int, pds::hash::double_hash_generator<int>>>(options);
+}
+
+template <typename Range>
+using range_stage = pds::blocked_bloom_filter<
+    int, pds::hash::simple_hash_generator<int, pds::hash::default_hash<int>,
+                                          Range>>;
+
+TEST(scalable_bloom_filter, FusedLookupWithEachRangeFunction) {
+    pds::scalable_options options;
+    options.initial_capacity = 500;
+    options.false_positive_probability = 0.01;
+    options.fused = true;
+    using hash_type = pds::hash::default_hash<int>::hash_type;
+    expect_fused_matches<range_stage<pds::hash::mod_range<hash_type>>>(options);
+    expect_fused_matches<range_stage<pds::hash::fast_mod_range<hash_type>>>(
+        options);
+    expect_fused_matches<range_stage<pds::hash::fast_range<hash_type>>>(
+        options);
+    expect_fused_matches<range_stage<pds::hash::pow_2_range<hash_type>>>(
+        options);
+    expect_fused_matches<pds::blocked_bloom_filter<
+        int, pds::hash::double_hash_generator<
+                 int, pds::hash::pow_2_range<uint64_t>>>>(options);
+}
+
+struct opaque_range {
+    uint64_t operator()(uint64_t hash, uint64_t range) const {
+        return hash % range;
+    }
+};
+
+TEST(scalable_bloom_filter, FusedLookupRejectsUnknownRangeFunction) {
+    using stage = pds::blocked_bloom_filter<
+        int, pds::hash::double_hash_generator<int, opaque_range>>;
+    pds::scalable_options options;
+    options.fused = true;
+    EXPECT_THROW((pds::scalable_bloom_filter<int, stage>(options)),
+                 std::invalid_argument);
+    options.fused = false;
+    pds::scalable_bloom_filter<int, stage> bf(options);
+    EXPECT_THROW(bf.set_fused(true), std::invalid_argument);
+}
+
+TEST(scalable_bloom_filter, EstimatedTriggerIgnoresDuplicates) {
+    pds::scalable_options options;
+    options.initial_capacity = 1000;
+    options.trigger = pds::growth_trigger::estimated_cardinality;
+    pds::scalable_bloom_filter<int> bf(options);
+    for (int round = 0; round < 10; ++round)
+        for (int i = 0; i < 500; ++i) bf.insert(i);
+    EXPECT_EQ(bf.num_stages(), 1);
+
+    options.trigger = pds::growth_trigger::insert_count;
+    pds::scalable_bloom_filter<int> counting(options);
+    for (int round = 0; round < 10; ++round)
+        for (int i = 0; i < 500; ++i) counting.insert(i);
+    EXPECT_GT(counting.num_stages(), 1);
+}
+
+TEST(scalable_bloom_filter, Clear) {
+    pds::scalable_bloom_filter<int> bf(100);
+    for (int i = 0; i < 1000; ++i) bf.insert(i);
+    EXPECT_GT(bf.num_stages(), 1);
+    bf.clear();
+    EXPECT_EQ(bf.num_stages(), 1);
+    EXPECT_EQ(bf.size(), 0);
+    EXPECT_EQ(bf.num_set_bits(), 0);
+}
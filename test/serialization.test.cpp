@@ -0,0 +1,137 @@
+#include "serialization.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using pds::serialization::format_error;
+
+TEST(crc32c, KnownValues) {
+    EXPECT_EQ(pds::crc32c("", 0), 0u);
+    EXPECT_EQ(pds::crc32c("123456789", 9), 0xE3069283u);
+    EXPECT_EQ(pds::crc32c_portable("123456789", 9), 0xE3069283u);
+    const std::vector<unsigned char> zeros(32, 0);
+    EXPECT_EQ(pds::crc32c(zeros.data(), zeros.size()), 0x8A9136AAu);
+}
+
+TEST(crc32c, AcceleratedMatchesPortable) {
+    std::mt19937_64 rng(7);
+    std::vector<unsigned char> buf(200000);
+    for (auto &b : buf) b = static_cast<unsigned char>(rng());
+    // Sizes around the interleaved stripe boundaries and odd tails.
+    for (std::size_t n : {0, 1, 7, 8, 9, 4095, 24575, 24576, 24577, 100003,
+                          200000}) {
+        EXPECT_EQ(pds::crc32c(buf.data(), n),
+                  pds::crc32c_portable(buf.data(), n))
+            << n;
+    }
+}
+
+TEST(crc32c, IncrementalAndCombine) {
+    const std::string s = "The quick brown fox jumps over the lazy dog";
+    const auto whole = pds::crc32c(s.data(), s.size());
+    const auto a = pds::crc32c(s.data(), 10);
+    const auto b = pds::crc32c(s.data() + 10, s.size() - 10);
+    EXPECT_EQ(pds::crc32c(s.data() + 10, s.size() - 10, a), whole);
+    EXPECT_EQ(pds::crc32c_combine(a, b, s.size() - 10), whole);
+}
+
+TEST(serialization, RoundTrip) {
+    pds::bloom_filter<int, pds::hash::double_hash_generator<int>> bf(5000,
+                                                                     0.01);
+    for (int i = 0; i < 5000; ++i) bf.insert(i);
+    std::stringstream ss;
+    pds::serialization::save(ss, bf);
+    EXPECT_EQ(ss.str().size(), pds::serialization::payload_offset +
+                                   bf.data().size() * sizeof(unsigned long) +
+                                   sizeof(std::uint32_t));
+
+    auto loaded = pds::serialization::load<decltype(bf)>(ss);
+    EXPECT_EQ(loaded.bit_capacity(), bf.bit_capacity());
+    EXPECT_EQ(loaded.hashes_per_key(), bf.hashes_per_key());
+    EXPECT_EQ(loaded.data(), bf.data());
+    for (int i = 0; i < 10000; ++i) EXPECT_EQ(loaded.contains(i), bf.contains(i));
+}
+
+TEST(serialization, RoundTripLargerThanOneChunk) {
+    pds::bloom_filter<int> bf(std::size_t{1} << 22, std::size_t{3});
+    for (int i = 0; i < 100000; ++i) bf.insert(i * 7);
+    std::stringstream ss;
+    pds::serialization::save(ss, bf);
+    auto loaded = pds::serialization::load<pds::bloom_filter<int>>(ss);
+    EXPECT_EQ(loaded.data(), bf.data());
+}
+
+TEST(serialization, DetectsCorruption) {
+    pds::bloom_filter<int> bf(1000, 0.01);
+    for (int i = 0; i < 1000; ++i) bf.insert(i);
+    std::stringstream ss;
+    pds::serialization::save(ss, bf);
+    const std::string bytes = ss.str();
+
+    auto flipped = bytes;
+    flipped[pds::serialization::payload_offset + 3] ^= 0x10;
+    std::stringstream corrupt(flipped);
+    EXPECT_THROW(pds::serialization::load<pds::bloom_filter<int>>(corrupt),
+                 format_error);
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 10));
+    EXPECT_THROW(pds::serialization::load<pds::bloom_filter<int>>(truncated),
+                 format_error);
+
+    auto bad_magic = bytes;
+    bad_magic[0] = 'X';
+    std::stringstream not_a_filter(bad_magic);
+    EXPECT_THROW(pds::serialization::load<pds::bloom_filter<int>>(not_a_filter),
+                 format_error);
+}
+
+TEST(serialization, RejectsMismatchedGenerator) {
+    pds::bloom_filter<int> bf(1000, 0.01);
+    std::stringstream ss;
+    pds::serialization::save(ss, bf);
+    using other = pds::bloom_filter<int, pds::hash::double_hash_generator<int>>;
+    EXPECT_THROW(pds::serialization::load<other>(ss), format_error);
+}
+
+template <typename Key>
+struct tagged_hash : pds::hash::murmer3_x86_32<Key> {};
+template <typename Key>
+struct untagged_hash : pds::hash::murmer3_x86_32<Key> {};
+
+template <typename Key>
+struct pds::serialization::hash_function_id<tagged_hash<Key>>
+    : std::integral_constant<std::uint32_t, 100> {};
+
+TEST(serialization, CustomHashNeedsAnId) {
+    using tagged = pds::hash::simple_hash_generator<int, tagged_hash<int>>;
+    using untagged =
+        pds::hash::simple_hash_generator<int, untagged_hash<int>>;
+    static_assert(pds::serialization::SerializableGenerator<tagged>);
+    static_assert(!pds::serialization::SerializableGenerator<untagged>);
+
+    pds::bloom_filter<int, tagged> bf(1000, 0.01);
+    for (int i = 0; i < 100; ++i) bf.insert(i);
+    std::stringstream ss;
+    pds::serialization::save(ss, bf);
+    using plain = pds::bloom_filter<int>;
+    EXPECT_THROW(pds::serialization::load<plain>(ss), format_error);
+    ss.seekg(0);
+    auto loaded = pds::serialization::load<decltype(bf)>(ss);
+    for (int i = 0; i < 100; ++i) EXPECT_TRUE(loaded.contains(i));
+}
+
+TEST(serialization, PreservesSeed) {
+    using generator = pds::hash::enhanced_double_hash_generator<int>;
+    pds::bloom_filter<int, generator> bf(generator(5, 1 << 16, 42));
+    for (int i = 0; i < 1000; ++i) bf.insert(i);
+    std::stringstream ss;
+    pds::serialization::save(ss, bf);
+    auto loaded = pds::serialization::load<decltype(bf)>(ss);
+    EXPECT_EQ(loaded.hash_generator().seed(), 42u);
+    for (int i = 0; i < 1000; ++i) EXPECT_TRUE(loaded.contains(i));
+}
@@ -0,0 +1,85 @@
+#include "split_block_bloom_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <random>
+#include <vector>
+
+using pds::simd::isa;
+
+TEST(split_block_bloom_filter, ContainsInsertedKeys) {
+    pds::split_block_bloom_filter<int> bf(1000, 0.01);
+    for (int i = 0; i < 1000; ++i) bf.insert(i);
+    for (int i = 0; i < 1000; ++i) EXPECT_TRUE(bf.contains(i));
+}
+
+TEST(split_block_bloom_filter, EightBitsPerKey) {
+    pds::split_block_bloom_filter<int> bf(1 << 12, (uint32_t)0);
+    bf.insert(42);
+    EXPECT_LE(bf.num_set_bits(), 8);
+    EXPECT_GE(bf.num_set_bits(), 1);
+}
+
+TEST(split_block_bloom_filter, FalsePositiveRate) {
+    pds::split_block_bloom_filter<int> bf(10000, 0.01);
+    for (int i = 0; i < 10000; ++i) bf.insert(2 * i);
+    auto fp = 0;
+    for (int i = 0; i < 10000; ++i) fp += bf.contains(2 * i + 1);
+    EXPECT_LT(fp / 10000.0, 0.03);
+}
+
+TEST(split_block_bloom_filter, IsaPathsAreBitIdentical) {
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> keys(5000);
+    for (auto &k : keys) k = rng();
+
+    pds::split_block_bloom_filter<uint64_t> reference(1 << 15, (uint32_t)3);
+    reference.set_isa(isa::scalar);
+    reference.insert(keys.begin(), keys.end());
+
+    for (auto path : {isa::avx2, isa::avx512}) {
+        if (!pds::simd::supports(path)) continue;
+        pds::split_block_bloom_filter<uint64_t> bf(1 << 15, (uint32_t)3);
+        bf.set_isa(path);
+        EXPECT_EQ(bf.isa(), path);
+        bf.insert(keys.begin(), keys.end());
+        ASSERT_EQ(bf.num_blocks(), reference.num_blocks());
+        EXPECT_EQ(std::memcmp(bf.data().data(), reference.data().data(),
+                              bf.data().size_bytes()),
+                  0);
+        for (int i = 0; i < 5000; ++i) {
+            auto probe = rng();
+            reference.set_isa(isa::scalar);
+            auto expected = reference.contains(probe);
+            reference.set_isa(path);
+            EXPECT_EQ(reference.contains(probe), expected);
+        }
+    }
+}
+
+TEST(split_block_bloom_filter, BatchMatchesSingleKeyOperations) {
+    std::vector<int> keys(1000);
+    std::iota(keys.begin(), keys.end(), 0);
+    pds::split_block_bloom_filter<int> bf(1000, 0.01);
+    bf.insert_batch(std::span<const int>(keys).first(500));
+    sul::dynamic_bitset<> bits(keys.size());
+    bf.contains_batch(keys, bits);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        EXPECT_EQ(bits[i], bf.contains(keys[i]));
+        if (i < 500) {
+            EXPECT_TRUE(bits[i]);
+        }
+    }
+}
+
+TEST(split_block_bloom_filter, StringViewLookups) {
+    pds::split_block_bloom_filter<std::string> bf(1000, 0.01);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; ++i) keys.push_back(std::to_string(i) + " keys");
+    bf.insert(keys.begin(), keys.end());
+    for (const auto &key : keys) EXPECT_TRUE(bf.contains(std::string_view(key)));
+}
@@ -0,0 +1,66 @@
+#include "static_bloom_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+TEST(static_bloom_filter, GeometryIsCompileTime) {
+    using filter = pds::static_bloom_filter<int, 1000, 5>;
+    static_assert(filter::bit_capacity() == 1000);
+    static_assert(filter::hashes_per_key() == 5);
+    static_assert(filter::num_words == 16);
+    static_assert(sizeof(filter) == 16 * sizeof(unsigned long));
+    filter bf;
+    EXPECT_TRUE(bf.empty());
+}
+
+TEST(static_bloom_filter, ContainsInsertedKeys) {
+    pds::static_bloom_filter<uint64_t, 1 << 14, 7> bf;
+    for (uint64_t i = 0; i < 1000; ++i) bf.insert(i);
+    for (uint64_t i = 0; i < 1000; ++i) EXPECT_TRUE(bf.contains(i));
+    EXPECT_LE(bf.num_set_bits(), 7000);
+    EXPECT_NEAR(bf.approximate_cardinality(), 1000, 50);
+    bf.clear();
+    EXPECT_TRUE(bf.empty());
+}
+
+TEST(static_bloom_filter, FalsePositiveRate) {
+    // ~10 bits per key, 7 hashes: about 1%.
+    pds::static_bloom_filter<int, 10000, 7> bf;
+    for (int i = 0; i < 1000; ++i) bf.insert(i);
+    int false_positives = 0;
+    for (int i = 1000; i < 101000; ++i) false_positives += bf.contains(i);
+    EXPECT_LT(false_positives, 2000);
+}
+
+TEST(static_bloom_filter, ThirtyTwoBitHash) {
+    pds::static_bloom_filter<int, 4096, 4, pds::hash::murmer3_x86_32<int>> bf;
+    for (int i = 0; i < 300; ++i) bf.insert(i);
+    for (int i = 0; i < 300; ++i) EXPECT_TRUE(bf.contains(i));
+    int false_positives = 0;
+    for (int i = 300; i < 10300; ++i) false_positives += bf.contains(i);
+    EXPECT_LT(false_positives, 500);
+}
+
+TEST(static_bloom_filter, SetAlgebra) {
+    pds::static_bloom_filter<int, 2048, 3> a, b;
+    for (int i = 0; i < 100; ++i) a.insert(i);
+    for (int i = 50; i < 150; ++i) b.insert(i);
+    const auto u = a | b;
+    for (int i = 0; i < 150; ++i) EXPECT_TRUE(u.contains(i));
+    const auto n = a & b;
+    for (int i = 50; i < 100; ++i) EXPECT_TRUE(n.contains(i));
+    auto c = a;
+    c |= a;
+    EXPECT_EQ(c, a);
+}
+
+TEST(static_bloom_filter, StringViewLookups) {
+    pds::static_bloom_filter<std::string, 4096, 4> bf;
+    const std::string key(64, 'k');
+    bf.insert(key);
+    EXPECT_TRUE(bf.contains(std::string_view(key)));
+    EXPECT_TRUE(bf.contains(std::string(64, 'k')));
+}
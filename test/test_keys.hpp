@@ -0,0 +1,28 @@
+#ifndef PDS_TEST_KEYS_HPP
+#define PDS_TEST_KEYS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Keys and measurements shared by the filter tests.
+
+inline std::vector<uint64_t> random_keys(std::size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> keys(n);
+    for (auto &key : keys) key = rng();
+    return keys;
+}
+
+// Fraction of trials random probes the filter reports. The probes use a seed
+// that no test draws its members with.
+template <typename Filter>
+double false_positive_rate(const Filter &filter, std::size_t trials) {
+    const auto probes = random_keys(trials, 99);
+    std::size_t hits = 0;
+    for (auto key : probes) hits += filter.contains(key);
+    return static_cast<double>(hits) / static_cast<double>(trials);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include "xor_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include "test_keys.hpp"
+
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+TEST(xor_filter, ContainsEveryKey) {
+    for (std::size_t n : {0, 1, 2, 10, 1000, 100000}) {
+        const auto keys = random_keys(n, n);
+        pds::xor8_filter<uint64_t> filter(keys.begin(), keys.end());
+        EXPECT_EQ(filter.size(), n);
+        for (auto key : keys) EXPECT_TRUE(filter.contains(key));
+    }
+}
+
+TEST(xor_filter, SpaceAndFalsePositiveRate) {
+    const auto keys = random_keys(200000, 1);
+    pds::xor8_filter<uint64_t> xor8(keys.begin(), keys.end());
+    pds::xor16_filter<uint64_t> xor16(keys.begin(), keys.end());
+    EXPECT_LT(xor8.bits_per_key(), 9.9);
+    EXPECT_LT(xor16.bits_per_key(), 19.8);
+    EXPECT_NEAR(false_positive_rate(xor8, 1000000),
+                xor8.false_positive_probability(), 0.001);
+    EXPECT_LT(false_positive_rate(xor16, 1000000), 0.0001);
+}
+
+TEST(xor_filter, DuplicateKeys) {
+    std::vector<int> keys(5000);
+    std::iota(keys.begin(), keys.end(), 0);
+    keys.insert(keys.end(), keys.begin(), keys.begin() + 2500);
+    keys.push_back(7);
+    pds::xor16_filter<int> filter(keys);
+    EXPECT_EQ(filter.size(), 5000u);
+    for (int key = 0; key < 5000; ++key) EXPECT_TRUE(filter.contains(key));
+}
+
+TEST(xor_filter, StringKeys) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; ++i) keys.push_back("key number " + std::to_string(i));
+    pds::xor8_filter<std::string> filter(keys.begin(), keys.end());
+    for (const auto &key : keys) {
+        EXPECT_TRUE(filter.contains(key));
+        EXPECT_TRUE(filter.contains(std::string_view(key)));
+    }
+}